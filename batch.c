@@ -0,0 +1,579 @@
+/************************ batch.c ***********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of batch mode.
+ * Regular files are mapped into memory and each line is
+ * compiled straight out of the mapping; pipes are read in
+ * large blocks instead. Large inputs are cut into chunks
+ * of whole lines, which a pool of threads evaluates into
+ * separate buffers that are then written in input order.
+ * Every thread keeps its own memo cache of unary results.
+ * Each line is compiled and run by the same compiler and
+ * VM as every other front end.
+ *
+ *******************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+#include "batch.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "expr.h"
+#include "format.h"
+#include "memo.h"
+#include "vm.h"
+
+/* Size of the input and output buffers */
+#define BLOCK_SIZE (1 << 20)
+
+/* Input evaluated by one thread at a time, and the most read from a pipe
+ * before it is shared between threads */
+#define CHUNK_SIZE (256 << 10)
+#define WINDOW_SIZE (64 * CHUNK_SIZE)
+
+/* Most threads a batch is split between */
+#define MAX_THREADS 256
+
+/* Longest output for one line: an error message or a number, plus '\n' */
+#define LINE_OUT_MAX 128
+
+/* Output buffer. If fd is a file descriptor the buffer is flushed to it
+ * when it fills up; if fd is -1 the buffer grows instead. */
+typedef struct Output {
+    int fd;
+    size_t len;
+    size_t cap;
+    bool failed; /* Is true once a write or allocation has failed */
+    char *buf;
+} Output;
+
+/* Writes len characters at buf to fd. Returns false on error, which is
+ * reported on stderr. */
+static bool write_all(int fd, const char *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = write(fd, buf + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("calc: write");
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return true;
+}
+
+/* Writes everything buffered in out to its file descriptor */
+static void flush(Output *out)
+{
+    if (!out->failed && !write_all(out->fd, out->buf, out->len)) {
+        out->failed = true;
+    }
+    out->len = 0;
+}
+
+/* Makes room in out for one more line of output. Returns false if there
+ * is none. */
+static bool reserve(Output *out)
+{
+    if (out->cap - out->len >= LINE_OUT_MAX) return true;
+    if (out->fd >= 0) {
+        flush(out);
+        return !out->failed;
+    }
+
+    size_t cap = (out->cap == 0) ? CHUNK_SIZE : out->cap * 2;
+    char *bigger = realloc(out->buf, cap);
+    if (bigger == NULL) {
+        out->failed = true;
+        return false;
+    }
+    out->buf = bigger;
+    out->cap = cap;
+    return true;
+}
+
+batch_line batch_eval_line(const char *line, size_t len, MemoCache *cache,
+                           double *value, ExprError *error)
+{
+    Program prog;
+
+    /* a trailing carriage return is just whitespace to the compiler */
+    size_t start = 0;
+    while (start < len && (line[start] == ' ' || line[start] == '\t' ||
+                           line[start] == '\r')) {
+        start++;
+    }
+    if (start == len) return BATCH_BLANK;
+
+    if (!expr_compile_const(&prog, line, len, error)) return BATCH_ERROR;
+
+    *value = vm_eval_memo(&prog, 0, cache);
+    return BATCH_VALUE;
+}
+
+/* Evaluates the expression in the len characters at line, writing its
+ * result and a newline to buf. Returns the number of characters written,
+ * or the negative of that number if the line failed to compile. */
+static int eval_line(const char *line, size_t len, char *buf,
+                     MemoCache *cache)
+{
+    double result;
+    ExprError error;
+    int n;
+
+    switch (batch_eval_line(line, len, cache, &result, &error)) {
+        case BATCH_BLANK:
+            buf[0] = '\n';
+            return 1;
+        case BATCH_ERROR:
+            n = snprintf(buf, LINE_OUT_MAX, "error: %s at column %zu\n",
+                         error.msg, error.pos + 1);
+            return -n;
+        default:
+            n = format_num(buf, FMT_LEN, result, FMT_MAX_DIGITS);
+            buf[n++] = '\n';
+            return n;
+    }
+}
+
+/* Evaluates the lines in the len characters at text, writing results to
+ * out. Unless last is true, a final line without a newline is left for a
+ * later call. Returns the number of characters consumed; sets *ok to false
+ * if any line failed to compile. */
+static size_t eval_lines(const char *text, size_t len, bool last,
+                         Output *out, bool *ok, MemoCache *cache)
+{
+    const char *line = text, *end = text + len;
+
+    while (line != end) {
+        const char *newline = memchr(line, '\n', end - line);
+        if (newline == NULL) {
+            if (!last) break;
+            newline = end;
+        }
+
+        if (!reserve(out)) break;
+        int written = eval_line(line, newline - line, out->buf + out->len,
+                                cache);
+        if (written < 0) {
+            *ok = false;
+            written = -written;
+        }
+        out->len += (size_t)written;
+
+        line = (newline == end) ? end : newline + 1;
+    }
+    return line - text;
+}
+
+/* A run of whole lines evaluated by one thread */
+typedef struct Chunk {
+    const char *text;
+    size_t len;
+    bool ok;          /* Is false if any line failed to compile */
+    Output out;       /* Results, waiting to be written */
+    atomic_bool done; /* Is true once out is complete */
+} Chunk;
+
+/* Chunks waiting to be evaluated by one thread: next, next + stride, and
+ * so on, up to but not including end. Other threads steal from the end. */
+typedef struct Deque {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} Deque;
+
+/* State shared by the threads evaluating one batch of chunks */
+typedef struct Pool {
+    Chunk *chunks;
+    size_t nchunks;
+    int nthreads;
+    Deque deques[MAX_THREADS];
+
+    /* Held by whichever thread is writing finished chunks. Chunks are
+     * written in order, so a thread that finishes a chunk out of order
+     * leaves it for the thread that finishes the one before it. */
+    atomic_bool writing;
+    size_t written; /* Chunks written so far, only used by the writer */
+    int fd;
+    bool failed;    /* Is true once a write has failed */
+} Pool;
+
+/* Argument of a pool thread */
+typedef struct Worker {
+    Pool *pool;
+    int self;
+    MemoCache *cache; /* The thread's own cache, or NULL to make one */
+} Worker;
+
+/* Takes the next chunk from deque d. Returns false if it is empty. */
+static bool pop(Pool *pool, int d, size_t *chunk)
+{
+    Deque *deque = &pool->deques[d];
+    bool found = false;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->next < deque->end) {
+        *chunk = deque->next;
+        deque->next += pool->nthreads;
+        found = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+/* Moves the last half of another thread's chunks to deque self, and takes
+ * the first of them. Returns false if every other deque is empty. */
+static bool steal(Pool *pool, int self, size_t *chunk)
+{
+    size_t stride = pool->nthreads;
+
+    for (int i = 1; i < pool->nthreads; i++) {
+        Deque *victim = &pool->deques[(self + i) % pool->nthreads];
+        size_t first = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            size_t count = (victim->end - victim->next + stride - 1) / stride;
+            end = victim->end;
+            first = victim->next + (count - (count + 1) / 2) * stride;
+            victim->end = first;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (first < end) {
+            Deque *own = &pool->deques[self];
+            pthread_mutex_lock(&own->lock);
+            own->next = first + stride;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+
+            *chunk = first;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Marks chunk c as done, then writes every finished chunk that is next in
+ * line, unless another thread is already doing so */
+static void finish(Pool *pool, size_t c)
+{
+    atomic_store(&pool->chunks[c].done, true);
+
+    while (!atomic_exchange(&pool->writing, true)) {
+        size_t written = pool->written;
+
+        while (written < pool->nchunks &&
+               atomic_load(&pool->chunks[written].done)) {
+            Output *out = &pool->chunks[written].out;
+            if (!pool->failed && (out->failed ||
+                                  !write_all(pool->fd, out->buf, out->len))) {
+                if (out->failed) fprintf(stderr, "calc: out of memory\n");
+                pool->failed = true;
+            }
+            free(out->buf);
+            out->buf = NULL;
+            written++;
+        }
+        pool->written = written;
+        atomic_store(&pool->writing, false);
+
+        /* a chunk finished after the check above is ours to write, as its
+         * thread may have found the writer busy */
+        if (written == pool->nchunks ||
+            !atomic_load(&pool->chunks[written].done)) {
+            break;
+        }
+    }
+}
+
+/* Evaluates chunks until there are none left to take or steal */
+static void *work(void *arg)
+{
+    Worker *worker = arg;
+    Pool *pool = worker->pool;
+    MemoCache *cache = worker->cache;
+    size_t c;
+
+    /* without memory for a cache, results are just computed every time */
+    if (cache == NULL) {
+        cache = malloc(sizeof(MemoCache));
+        if (cache != NULL) memo_init(cache);
+    }
+
+    while (pop(pool, worker->self, &c) || steal(pool, worker->self, &c)) {
+        Chunk *chunk = &pool->chunks[c];
+        eval_lines(chunk->text, chunk->len, true, &chunk->out, &chunk->ok,
+                   cache);
+        finish(pool, c);
+    }
+
+    if (cache != worker->cache) free(cache);
+    return NULL;
+}
+
+/* Returns the number of threads to use for a batch */
+static int thread_count(int threads)
+{
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (int)cpus : 1;
+    }
+    return (threads > MAX_THREADS) ? MAX_THREADS : threads;
+}
+
+/* Evaluates the whole lines in the len characters at text, and a final
+ * line without a newline too if last is true, using the given number of
+ * threads. Results are written to out in input order. The calling thread
+ * uses cache, and every other thread makes its own. Returns the number of
+ * characters consumed, like eval_lines. */
+static size_t eval_text(const char *text, size_t len, bool last,
+                        Output *out, bool *ok, int threads, MemoCache *cache)
+{
+    if (threads <= 1 || len < 2 * CHUNK_SIZE) {
+        return eval_lines(text, len, last, out, ok, cache);
+    }
+
+    /* leave an unfinished last line for the next call */
+    size_t used = len;
+    if (!last) {
+        while (used > 0 && text[used - 1] != '\n') used--;
+    }
+
+    /* a window without a newline is one line still being read */
+    if (used == 0) return 0;
+
+    /* cut the text into chunks, each ending just after a newline */
+    size_t max_chunks = used / CHUNK_SIZE + 1;
+    Pool *pool = malloc(sizeof(Pool));
+    Chunk *chunks = calloc(max_chunks, sizeof(Chunk));
+    if (pool == NULL || chunks == NULL) {
+        free(pool);
+        free(chunks);
+        return eval_lines(text, len, last, out, ok, cache);
+    }
+
+    size_t nchunks = 0;
+    for (size_t start = 0; start < used; nchunks++) {
+        size_t end = start + CHUNK_SIZE;
+        if (end >= used) {
+            end = used;
+        } else {
+            const char *newline = memchr(text + end, '\n', used - end);
+            end = (newline == NULL) ? used : (size_t)(newline - text) + 1;
+        }
+        chunks[nchunks].text = text + start;
+        chunks[nchunks].len = end - start;
+        chunks[nchunks].ok = true;
+        chunks[nchunks].out.fd = -1;
+        atomic_init(&chunks[nchunks].done, false);
+        start = end;
+    }
+
+    /* earlier results must be written before any chunk's */
+    flush(out);
+
+    /* deal the chunks out in turn, so that they finish roughly in order
+     * and few results wait to be written */
+    if (threads > (int)nchunks) threads = (nchunks > 0) ? (int)nchunks : 1;
+    pool->chunks = chunks;
+    pool->nchunks = nchunks;
+    pool->nthreads = threads;
+    atomic_init(&pool->writing, false);
+    pool->written = 0;
+    pool->fd = out->fd;
+    pool->failed = out->failed;
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->deques[i].next = i;
+        pool->deques[i].end = nchunks;
+    }
+
+    /* the calling thread works too */
+    Worker workers[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    int started = 1;
+    for (int i = 0; i < threads; i++) {
+        workers[i].pool = pool;
+        workers[i].self = i;
+        workers[i].cache = (i == 0) ? cache : NULL;
+    }
+    for (; started < threads; started++) {
+        if (pthread_create(&ids[started], NULL, work,
+                           &workers[started]) != 0) {
+            break;
+        }
+    }
+    work(&workers[0]);
+    for (int i = 1; i < started; i++) pthread_join(ids[i], NULL);
+
+    for (size_t i = 0; i < nchunks; i++) *ok = *ok && chunks[i].ok;
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    out->failed = pool->failed;
+    free(pool);
+    free(chunks);
+    return used;
+}
+
+/* Allocates an output buffer for out_fd, or returns NULL */
+static Output *new_output(int out_fd)
+{
+    Output *out = malloc(sizeof(Output));
+    char *buf = malloc(BLOCK_SIZE);
+
+    if (out == NULL || buf == NULL) {
+        fprintf(stderr, "calc: out of memory\n");
+        free(out);
+        free(buf);
+        return NULL;
+    }
+    out->fd = out_fd;
+    out->len = 0;
+    out->cap = BLOCK_SIZE;
+    out->failed = false;
+    out->buf = buf;
+    return out;
+}
+
+/* Flushes and frees out. Returns false if any write failed. */
+static bool free_output(Output *out)
+{
+    flush(out);
+    bool ok = !out->failed;
+    free(out->buf);
+    free(out);
+    return ok;
+}
+
+bool batch_run_stream(int in, int out_fd, int threads)
+{
+    Output *out = new_output(out_fd);
+    MemoCache *cache = malloc(sizeof(MemoCache));
+    threads = thread_count(threads);
+
+    /* with several threads, a window of lines is read before they start */
+    size_t want = (threads > 1) ? WINDOW_SIZE : BLOCK_SIZE;
+    size_t cap = want;
+    char *buf = malloc(cap);
+    size_t len = 0;   /* characters in buf */
+    bool ok = true, eof = false;
+
+    if (out == NULL || buf == NULL || cache == NULL) {
+        if (out != NULL) {
+            fprintf(stderr, "calc: out of memory\n");
+            free_output(out);
+        }
+        free(cache);
+        free(buf);
+        return false;
+    }
+    memo_init(cache);
+
+    while (!eof && !out->failed) {
+        /* grow the buffer if one line fills all of it */
+        if (len == cap) {
+            char *bigger = realloc(buf, cap * 2);
+            if (bigger == NULL) {
+                fprintf(stderr, "calc: line too long\n");
+                ok = false;
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+
+        ssize_t n = read(in, buf + len, cap - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("calc: read");
+            ok = false;
+            break;
+        }
+        eof = (n == 0);
+        len += (size_t)n;
+
+        /* read on until the window is full, unless the input has ended */
+        if (!eof && len < want) continue;
+
+        /* keep the unfinished line for the next read */
+        size_t used = eval_text(buf, len, eof, out, &ok, threads, cache);
+        len -= used;
+        memmove(buf, buf + used, len);
+    }
+
+    ok = free_output(out) && ok;
+    free(cache);
+    free(buf);
+    return ok;
+}
+
+bool batch_run_threads(int in, int out_fd, int threads)
+{
+    struct stat st;
+
+    /* pipes, terminals and empty files cannot be mapped */
+    if (fstat(in, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (unsigned long long)st.st_size > SIZE_MAX) {
+        return batch_run_stream(in, out_fd, threads);
+    }
+
+    size_t len = (size_t)st.st_size;
+    char *text = mmap(NULL, len, PROT_READ, MAP_PRIVATE, in, 0);
+    if (text == MAP_FAILED) return batch_run_stream(in, out_fd, threads);
+
+    /* lines are read once, front to back */
+    posix_madvise(text, len, POSIX_MADV_SEQUENTIAL);
+
+    Output *out = new_output(out_fd);
+    MemoCache *cache = malloc(sizeof(MemoCache));
+    bool ok = (out != NULL && cache != NULL);
+    if (ok) {
+        memo_init(cache);
+        eval_text(text, len, true, out, &ok, thread_count(threads), cache);
+        ok = free_output(out) && ok;
+    } else if (out != NULL) {
+        fprintf(stderr, "calc: out of memory\n");
+        free_output(out);
+    }
+    free(cache);
+
+    munmap(text, len);
+    return ok;
+}
+
+bool batch_run(int in, int out_fd)
+{
+    return batch_run_threads(in, out_fd, 0);
+}
+
+int batch_run_file(const char *path)
+{
+    int in = STDIN_FILENO;
+
+    if (path != NULL) {
+        in = open(path, O_RDONLY);
+        if (in < 0) {
+            perror(path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool ok = batch_run(in, STDOUT_FILENO);
+
+    if (path != NULL) close(in);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,59 @@
+/************************ batch.h ***********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to batch mode, which evaluates a stream of
+ * expressions, one per line, without any user interface.
+ *
+ *******************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "expr.h"
+#include "memo.h"
+
+/* Outcome of evaluating one line */
+typedef enum {
+    BATCH_BLANK, /* the line holds only blanks */
+    BATCH_VALUE, /* the line's expression was evaluated */
+    BATCH_ERROR  /* the line's expression failed to compile */
+} batch_line;
+
+/* Evaluates the expression in the len characters at line, which need not
+ * be NUL-terminated, using cache. Spaces, tabs and carriage returns are
+ * blanks, so CRLF line ends are accepted. Stores the value in *value for
+ * BATCH_VALUE, or fills in error for BATCH_ERROR; the variable x is an
+ * error, as it has no value here. Every line of batch mode goes through
+ * this function. */
+batch_line batch_eval_line(const char *line, size_t len, MemoCache *cache,
+                           double *value, ExprError *error);
+
+/* Reads expressions from the file descriptor in, one per line, and writes
+ * each result on its own line to the file descriptor out. Results are the
+ * shortest text that reads back as the exact double; an empty line gives
+ * an empty line, and a line that fails to compile gives "error: " and the
+ * reason. Returns false if any line failed or on an I/O error, which is
+ * reported on stderr.
+ *
+ * If in is a regular file it is mapped into memory and expressions are
+ * compiled in place, without being copied; otherwise batch_run_stream is
+ * used. The file must not be truncated while it is being read. Large
+ * inputs are shared between one thread per processor; results are always
+ * written in input order. */
+bool batch_run(int in, int out);
+
+/* Same as batch_run, but uses the given number of threads, or one per
+ * processor if threads is 0 */
+bool batch_run_threads(int in, int out, int threads);
+
+/* Same as batch_run_threads, but always reads in through a buffer, as it
+ * must for pipes and terminals */
+bool batch_run_stream(int in, int out, int threads);
+
+/* Runs batch_run on the file at path, or on standard input if path is
+ * NULL, writing to standard output. Returns an exit status for main. */
+int batch_run_file(const char *path);
+
+#endif
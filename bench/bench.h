@@ -0,0 +1,53 @@
+/*********************** bench.h ************************
+ * Author: Jeremy Lawrence
+ *
+ * Helpers shared by the benchmarks in this directory.
+ *
+ *******************************************************/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Returns a monotonic timestamp in seconds */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Stores a value where the compiler cannot optimize it away */
+static volatile double sink;
+
+/* Orders doubles for qsort */
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Prints the heading of report_percentiles' columns, in unit */
+static void report_heading(const char *name, const char *unit)
+{
+    printf("%-22s %8s %6s %-2s %6s %-2s %6s %-2s %6s %-2s\n", name,
+           "samples", "p50", unit, "p90", unit, "p99", unit, "max", unit);
+}
+
+/* Sorts n samples and prints their percentiles, multiplied by scale */
+static void report_percentiles(const char *name, double *samples, size_t n,
+                               double scale)
+{
+    if (n == 0) return;
+
+    qsort(samples, n, sizeof(double), compare);
+    printf("%-22s %8zu %9.2f %9.2f %9.2f %9.2f\n", name, n,
+           samples[n / 2] * scale, samples[n * 9 / 10] * scale,
+           samples[n * 99 / 100] * scale, samples[n - 1] * scale);
+}
+
+#endif
@@ -0,0 +1,154 @@
+/******************** bench_batch.c *********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures batch mode throughput on a generated file of
+ * expressions, reading it through a buffer as a pipe would
+ * be read (batch_run_stream) and through a memory mapping
+ * (batch_run_threads), first on one thread and then on 1
+ * to N threads. Results are written to /dev/null.
+ *
+ * Usage: bench_batch [megabytes] [file] [threads]
+ *
+ * The file is generated, then removed unless it was named
+ * on the command line. Before timing anything, a single
+ * line longer than the stream's read window is run on 4
+ * threads, which must give exactly one line of output.
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../batch.h"
+
+/* Writes about megabytes of expressions to path. Returns the number of
+ * lines written, or -1 on error. */
+static long generate(const char *path, long megabytes)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return -1;
+
+    unsigned long seed = 12345;
+    long size = 0, lines = 0;
+
+    while (size < megabytes << 20) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        unsigned long r = seed >> 33;
+        int n;
+
+        switch (lines % 4) {
+            case 0:
+                n = fprintf(f, "%lu × %lu.%02lu + √%lu\n", r % 10000,
+                            r % 1000, r % 100, r % 97);
+                break;
+            case 1:
+                n = fprintf(f, "(%lu + %lu) ÷ %lu\n", r % 1000,
+                            r % 777, r % 13 + 1);
+                break;
+            case 2:
+                n = fprintf(f, "-%lu.%lu² + %lu%%\n", r % 100, r % 10,
+                            r % 500);
+                break;
+            default:
+                n = fprintf(f, "sin %lu + cos %lu × %lu!\n", r % 7,
+                            r % 11, r % 10);
+        }
+        if (n < 0) break;
+        size += n;
+        lines++;
+    }
+
+    if (fclose(f) != 0 || size < megabytes << 20) return -1;
+    return lines;
+}
+
+/* Streams one line of more than 16 MiB, the read window used with several
+ * threads, through batch_run_stream on 4 threads. Returns false unless it
+ * gives one line of output. */
+static bool check_long_line(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return false;
+    for (long i = 0; i < (17L << 20) / 2; i++) fputs("1+", f);
+    fputs("1\n", f);
+    if (fclose(f) != 0) return false;
+
+    char out_path[] = "/tmp/bench_batch_XXXXXX";
+    int in = open(path, O_RDONLY);
+    int out = mkstemp(out_path);
+    if (in < 0 || out < 0) return false;
+
+    batch_run_stream(in, out, 4);
+    char buf[256];
+    ssize_t n = pread(out, buf, sizeof(buf), 0);
+
+    close(in);
+    close(out);
+    remove(out_path);
+    remove(path);
+    return n > 0 && memchr(buf, '\n', (size_t)n) == buf + n - 1;
+}
+
+/* Runs run on the file at path with output to /dev/null, returning the
+ * time taken in seconds. The faster of two runs is kept, so that every
+ * run sees the file in the page cache. */
+static double time_run(bool (*run)(int, int, int), const char *path,
+                       int threads)
+{
+    double best = 1e300;
+
+    for (int i = 0; i < 2; i++) {
+        int in = open(path, O_RDONLY);
+        int out = open("/dev/null", O_WRONLY);
+        if (in < 0 || out < 0) exit(1);
+
+        double start = now();
+        run(in, out, threads);
+        double elapsed = now() - start;
+        if (elapsed < best) best = elapsed;
+
+        close(in);
+        close(out);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    long megabytes = (argc > 1) ? atol(argv[1]) : 2048;
+    const char *path = (argc > 2) ? argv[2] : "bench_batch.txt";
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (argc > 3) ? atoi(argv[3]) : (cpus > 0) ? (int)cpus : 1;
+
+    if (!check_long_line(path)) {
+        fprintf(stderr, "%s: long line not evaluated as one line\n", path);
+        return 1;
+    }
+
+    long lines = generate(path, megabytes);
+    if (lines < 0) {
+        perror(path);
+        return 1;
+    }
+
+    double stream = time_run(batch_run_stream, path, 1);
+    double mapped = time_run(batch_run_threads, path, 1);
+
+    printf("%ld MB, %ld lines\n", megabytes, lines);
+    printf("stream     %8.1f MB/s %8.2f Mlines/s\n", megabytes / stream,
+           lines / stream / 1e6);
+    printf("mapped     %8.1f MB/s %8.2f Mlines/s (%.2fx)\n",
+           megabytes / mapped, lines / mapped / 1e6, stream / mapped);
+
+    for (int t = 1; t <= threads; t++) {
+        double elapsed = time_run(batch_run_threads, path, t);
+        printf("%2d threads %8.1f MB/s %8.2f Mlines/s (%.2fx)\n", t,
+               megabytes / elapsed, lines / elapsed / 1e6, mapped / elapsed);
+    }
+
+    if (argc <= 2) remove(path);
+    return 0;
+}
@@ -0,0 +1,77 @@
+/******************** bench_column.c ********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures column mode throughput, in values per second,
+ * for each instruction set the machine supports, against
+ * calling the VM once per value.
+ *
+ * Usage: bench_column [number of values]
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../expr.h"
+#include "../vm.h"
+#include "../column.h"
+
+/* Expressions in the variable x */
+static const char *expressions[] = {
+    "x × x + 2 × x + 1",
+    "(x - 1) ÷ (x + 1)",
+    "√x + x² - x³ ÷ 3",
+    "∛x + 5% × x",
+    "sin x + cos x",
+};
+
+/* Names of the instruction sets, indexed by isa */
+static const char *isa_names[] = { "auto", "scalar", "sse2", "avx2" };
+
+int main(int argc, char *argv[])
+{
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+    double *x = malloc(n * sizeof(double));
+    double *out = malloc(n * sizeof(double));
+    double *expected = malloc(n * sizeof(double));
+    if (x == NULL || out == NULL || expected == NULL) return 1;
+
+    for (size_t i = 0; i < n; i++) x[i] = 1 + (double)i / 1000;
+
+    printf("column_eval uses %s on this machine\n\n", isa_names[column_isa()]);
+    printf("%-26s %-8s %14s\n", "expression", "path", "values/s");
+
+    for (size_t e = 0; e < sizeof(expressions) / sizeof(*expressions); e++) {
+        Program prog;
+        ExprError error;
+
+        if (!expr_compile(&prog, expressions[e], strlen(expressions[e]),
+                          &error)) {
+            fprintf(stderr, "%s: %s\n", expressions[e], error.msg);
+            return 1;
+        }
+
+        double start = now();
+        for (size_t i = 0; i < n; i++) expected[i] = vm_eval(&prog, x[i]);
+        printf("%-26s %-8s %14.3e\n", expressions[e], "vm",
+               n / (now() - start));
+
+        for (isa set = ISA_SCALAR; set <= ISA_AVX2; set++) {
+            start = now();
+            if (!column_eval_isa(&prog, x, out, n, set)) continue;
+            double elapsed = now() - start;
+
+            if (memcmp(out, expected, n * sizeof(double)) != 0) {
+                fprintf(stderr, "%s: %s differs from vm\n", expressions[e],
+                        isa_names[set]);
+                return 1;
+            }
+            printf("%-26s %-8s %14.3e\n", "", isa_names[set], n / elapsed);
+        }
+    }
+
+    free(x);
+    free(out);
+    free(expected);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/******************* bench_dispatch.c *******************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how long it takes to find the key a button
+ * press stands for. Buttons used to be told apart by
+ * their labels, walking the str_to_op and str_to_special
+ * strcmp chains; they now pass the character that
+ * engine_char_key maps to their key.
+ *
+ * Usage: bench_dispatch [presses]
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../engine.h"
+
+/* Every key of the calculator, as its label and its character */
+static const struct { const char *label; char c; } buttons[] = {
+    { "0", '0' }, { "1", '1' }, { "2", '2' }, { "3", '3' }, { "4", '4' },
+    { "5", '5' }, { "6", '6' }, { "7", '7' }, { "8", '8' }, { "9", '9' },
+    { ".", '.' }, { "÷", '/' }, { "×", '*' }, { "+", '+' },
+    { "-", '-' }, { "=", '=' }, { "x!", '!' }, { "√x", 'r' },
+    { "∛x", 'R' }, { "+/-", '~' }, { "%", '%' }, { "x²", 'q' },
+    { "x³", 'Q' }, { "sin", 's' }, { "cos", 'c' }, { "tan", 't' },
+    { "C", 'C' }
+};
+#define BUTTONS (sizeof(buttons) / sizeof(*buttons))
+
+/* Returns the key for a button label, the way the callbacks used to */
+static key label_key(const char *label)
+{
+    if (label[0] >= '0' && label[0] <= '9' && label[1] == '\0') {
+        return (key)(KEY_0 + (label[0] - '0'));
+    }
+    if (strcmp(label, ".") == 0) return KEY_POINT;
+    if (strcmp(label, "C") == 0) return KEY_CLEAR;
+    if (strcmp(label, "=") == 0) return KEY_EQUALS;
+
+    operator op = str_to_op(label);
+    if (op != DEFAULT) return (key)(KEY_DIV + op);
+
+    special sp = str_to_special(label);
+    return (sp != NUL) ? (key)(KEY_FAC + sp) : KEY_NONE;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 20000000;
+    unsigned char *presses = malloc(n);
+    if (n <= 0 || presses == NULL) return 1;
+
+    /* both ways must agree on every button */
+    for (size_t b = 0; b < BUTTONS; b++) {
+        if (label_key(buttons[b].label) != engine_char_key(buttons[b].c)) {
+            fprintf(stderr, "%s: keys differ\n", buttons[b].label);
+            return 1;
+        }
+    }
+
+    unsigned long seed = 42;
+    for (long i = 0; i < n; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        presses[i] = (unsigned char)((seed >> 33) % BUTTONS);
+    }
+
+    unsigned long total = 0;
+    double start = now();
+    for (long i = 0; i < n; i++) {
+        total += label_key(buttons[presses[i]].label);
+    }
+    double by_label = (now() - start) * 1e9 / n;
+    sink = (double)total;
+
+    total = 0;
+    start = now();
+    for (long i = 0; i < n; i++) {
+        total += engine_char_key(buttons[presses[i]].c);
+    }
+    double by_char = (now() - start) * 1e9 / n;
+    sink = (double)total;
+
+    printf("%-16s %10s\n", "dispatch", "ns/press");
+    printf("%-16s %10.2f\n", "label strcmp", by_label);
+    printf("%-16s %10.2f\n", "engine_char_key", by_char);
+    printf("speedup: %.1fx\n", by_label / by_char);
+
+    free(presses);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/******************* bench_display.c ********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures what a display update costs with CalcDisplay
+ * and with the GtkFrame label it replaced. The real layout
+ * is built from calc.ui; for the label, the display in
+ * its frame is swapped for the frame's own label, as it
+ * used to be. The text is changed once per frame, cycling
+ * through typed numbers, results and long values, and
+ * both the call setting it and the frame that shows it
+ * (from before-paint to after-paint, so layout and
+ * drawing) are timed.
+ *
+ * Usage: xvfb-run -a bench/bench_display [updates]
+ *
+ * Needs GTK and a display; xvfb-run provides a virtual
+ * one.
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../display.h"
+
+/* Texts shown in turn; no two in a row are alike */
+static const char *texts[] = {
+    "7", "78", "789", "789.", "789.5", "+", "3", "792.5", "÷", "3",
+    "264.166666667", "0.333333333333", "1.23456789012e+300", "inf",
+    "-12345678901234567890123456789012", "0"
+};
+#define TEXTS (sizeof(texts) / sizeof(*texts))
+
+static double frame_start; /* When the frame being drawn started */
+static double frame_time;  /* How long the last frame took */
+static bool painted;       /* Is true once a frame has been drawn */
+
+static void before_paint(GdkFrameClock *clock, gpointer user_data)
+{
+    (void)clock;
+    (void)user_data;
+
+    frame_start = now();
+}
+
+static void after_paint(GdkFrameClock *clock, gpointer user_data)
+{
+    (void)clock;
+    (void)user_data;
+
+    frame_time = now() - frame_start;
+    painted = true;
+}
+
+/* Waits for the next frame to be drawn */
+static void wait_frame(void)
+{
+    painted = false;
+    while (!painted) g_main_context_iteration(NULL, TRUE);
+}
+
+/* Shows n texts in a new window, with CalcDisplay or, if label is true,
+ * with the frame's label. Prints how long they took. */
+static void run(long n, bool label)
+{
+    double *set_times = malloc(n * sizeof(double));
+    double *frame_times = malloc(n * sizeof(double));
+    if (set_times == NULL || frame_times == NULL) exit(1);
+
+    GtkBuilder *builder =
+        gtk_builder_new_from_resource("/com/example/calc/calc.ui");
+    GtkWidget *grid = GTK_WIDGET(gtk_builder_get_object(builder, "grid"));
+    GtkWidget *display =
+        GTK_WIDGET(gtk_builder_get_object(builder, "display"));
+    GtkWidget *frame = gtk_widget_get_parent(display);
+
+    if (label) {
+        gtk_frame_set_child(GTK_FRAME(frame), NULL);
+        gtk_frame_set_label(GTK_FRAME(frame), "0");
+        gtk_frame_set_label_align(GTK_FRAME(frame), 1);
+    }
+
+    GtkWidget *window = gtk_window_new();
+    gtk_window_set_default_size(GTK_WINDOW(window), 400, 400);
+    gtk_window_set_child(GTK_WINDOW(window), grid);
+    g_object_unref(builder);
+
+    gtk_widget_realize(window);
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(window);
+    g_signal_connect(clock, "before-paint", G_CALLBACK(before_paint), NULL);
+    g_signal_connect(clock, "after-paint", G_CALLBACK(after_paint), NULL);
+    gtk_window_present(GTK_WINDOW(window));
+    wait_frame();
+
+    for (long i = 0; i < n; i++) {
+        const char *text = texts[i % TEXTS];
+
+        double start = now();
+        if (label) {
+            gtk_frame_set_label(GTK_FRAME(frame), text);
+        } else {
+            calc_display_set_text(CALC_DISPLAY(display), text);
+        }
+        set_times[i] = now() - start;
+
+        wait_frame();
+        frame_times[i] = frame_time;
+    }
+
+    const char *name = label ? "frame label" : "CalcDisplay";
+    char row[64];
+    snprintf(row, sizeof(row), "%s set", name);
+    report_percentiles(row, set_times, n, 1e6);
+    snprintf(row, sizeof(row), "%s frame", name);
+    report_percentiles(row, frame_times, n, 1e6);
+
+    g_signal_handlers_disconnect_by_func(clock, before_paint, NULL);
+    g_signal_handlers_disconnect_by_func(clock, after_paint, NULL);
+    gtk_window_destroy(GTK_WINDOW(window));
+    free(set_times);
+    free(frame_times);
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 500;
+    if (n <= 0) return 1;
+
+    gtk_init();
+    g_type_ensure(CALC_TYPE_DISPLAY);
+
+    report_heading("update", "us");
+    run(n, true);
+    run(n, false);
+    return 0;
+}
@@ -0,0 +1,105 @@
+/******************** bench_engine.c ********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how fast the engine's keypad state machine
+ * handles keystrokes. Recorded key streams of different
+ * mixes are replayed with engine_batch, as batch callers
+ * do, and once more asking for the display text after
+ * every key, as the GUI does.
+ *
+ * Usage: bench_engine [keys per stream]
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../engine.h"
+
+/* Percentage of digits, points, binary operators and special keys in a
+ * stream; the rest are "=" and "C" */
+typedef struct Mix {
+    const char *name;
+    int digits, points, binary, special;
+} Mix;
+
+/* Fills keys with n keystrokes drawn according to mix. Returns the number
+ * of "=" keys. */
+static size_t fill(key *keys, size_t n, const Mix *mix)
+{
+    unsigned long seed = 42;
+    size_t equals = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        unsigned long r = seed >> 33;
+        int p = (int)(r % 100);
+        r /= 100;
+
+        if ((p -= mix->digits) < 0) {
+            keys[i] = (key)(KEY_0 + r % 10);
+        } else if ((p -= mix->points) < 0) {
+            keys[i] = KEY_POINT;
+        } else if ((p -= mix->binary) < 0) {
+            keys[i] = (key)(KEY_DIV + r % 4);
+        } else if ((p -= mix->special) < 0) {
+            keys[i] = (key)(KEY_FAC + r % 10);
+        } else {
+            keys[i] = (r % 8 == 0) ? KEY_CLEAR : KEY_EQUALS;
+        }
+        if (keys[i] == KEY_EQUALS) equals++;
+    }
+    return equals;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 10000000;
+    static const Mix mixes[] = {
+        { "typing",  70, 5, 12, 3 },
+        { "unary",   40, 5, 10, 35 },
+        { "uniform", 37, 4, 15, 37 }
+    };
+    key *keys = malloc(n * sizeof(key));
+    double *results = malloc(n * sizeof(double));
+    Engine *engine = engine_new();
+    if (n <= 0 || keys == NULL || results == NULL || engine == NULL) {
+        return 1;
+    }
+
+    printf("%-8s %10s %10s %10s %10s\n", "stream", "batch ns",
+           "Mkeys/s", "display ns", "Mkeys/s");
+
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(*mixes); m++) {
+        size_t equals = fill(keys, n, &mixes[m]);
+
+        engine_clear(engine);
+        double start = now();
+        size_t count = engine_batch(engine, keys, n, results);
+        double batch = (now() - start) / n;
+        if (count != equals) {
+            fprintf(stderr, "%s: %zu results, expected %zu\n",
+                    mixes[m].name, count, equals);
+            return 1;
+        }
+        sink = results[count / 2];
+
+        engine_clear(engine);
+        size_t length = 0;
+        start = now();
+        for (long i = 0; i < n; i++) {
+            engine_key(engine, keys[i]);
+            length += strlen(engine_display(engine));
+        }
+        double display = (now() - start) / n;
+        sink = (double)length;
+
+        printf("%-8s %10.2f %10.1f %10.2f %10.1f\n", mixes[m].name,
+               batch * 1e9, 1e-6 / batch, display * 1e9, 1e-6 / display);
+    }
+
+    engine_free(engine);
+    free(keys);
+    free(results);
+    return 0;
+}
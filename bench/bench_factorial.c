@@ -0,0 +1,74 @@
+/****************** bench_factorial.c *******************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how long one factorial takes with tgamma, as
+ * the x! key used to compute it, and with factorial, for
+ * integer and non-integer arguments, and counts how many
+ * integer factorials tgamma gets wrong.
+ *
+ * Usage: bench_factorial [factorials per test]
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../factorial.h"
+
+/* Returns nanoseconds per call of f over the n arguments in args */
+static double time_fn(double (*f)(double), const double *args, long n)
+{
+    double total = 0;
+    double start = now();
+
+    for (long i = 0; i < n; i++) total += f(args[i]);
+
+    double elapsed = now() - start;
+    sink = total;
+    return elapsed * 1e9 / n;
+}
+
+/* The x! key before factorial */
+static double gamma_factorial(double a)
+{
+    return tgamma(a + 1);
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 5000000;
+    double *ints = malloc(n * sizeof(double));
+    double *fracs = malloc(n * sizeof(double));
+    if (ints == NULL || fracs == NULL) return 1;
+
+    for (long i = 0; i < n; i++) {
+        ints[i] = (double)(i * 7 % (FACTORIAL_MAX + 1));
+        fracs[i] = ints[i] + 0.5;
+    }
+
+    int wrong = 0;
+    for (int i = 0; i <= FACTORIAL_MAX; i++) {
+        if (tgamma(i + 1.0) != factorial(i)) wrong++;
+    }
+
+    printf("%-12s %10s %10s %8s\n", "arguments", "tgamma ns", "table ns",
+           "speedup");
+
+    double gamma = time_fn(gamma_factorial, ints, n);
+    double table = time_fn(factorial, ints, n);
+    printf("%-12s %10.2f %10.2f %7.2fx\n", "integers", gamma, table,
+           gamma / table);
+
+    gamma = time_fn(gamma_factorial, fracs, n);
+    table = time_fn(factorial, fracs, n);
+    printf("%-12s %10.2f %10.2f %7.2fx\n", "non-integers", gamma, table,
+           gamma / table);
+
+    printf("tgamma is not the nearest double for %d of 0! to %d!\n", wrong,
+           FACTORIAL_MAX);
+
+    free(ints);
+    free(fracs);
+    return 0;
+}
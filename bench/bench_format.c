@@ -0,0 +1,96 @@
+/******************** bench_format.c ********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how long formatting one number for the display
+ * takes with the old probe loop (up to eight rounds of
+ * pow, round and snprintf), with format_num, and with
+ * format_bulk writing every number into one arena.
+ *
+ * Usage: bench_format [numbers to format]
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "../format.h"
+
+#define TOL 0.0000001
+#define TOT_DIGITS 12
+#define MAX_PRECISION 7
+
+/* The display formatting the engine used before format_num */
+static char *precise_num2str(double num, int precision)
+{
+    static char buffer[TOT_DIGITS + 1];
+    snprintf(buffer, sizeof(buffer), "%.*f", precision, num);
+    return buffer;
+}
+
+static char *old_num2str(double num)
+{
+    if (num == 0) return precise_num2str(0, 0);
+
+    for (int i = 0; i <= MAX_PRECISION; i++) {
+        double factor = pow(10, i);
+        int shifted = round(num * factor);
+        double rounded = (double)shifted / factor;
+        if (fabs(num - rounded) < TOL) return precise_num2str(rounded, i);
+    }
+
+    int int_part = (int)num;
+    int int_digits = (int_part == 0) ? 0 : ceil(log10(abs(int_part)));
+    int precision = TOT_DIGITS - int_digits;
+    if (precision < 0) precision = 0;
+    return precise_num2str(num, precision);
+}
+
+/* Kinds of numbers a calculator shows */
+static double sample(long i)
+{
+    switch (i % 4) {
+        case 0:  return (double)(i % 100000);          /* integers */
+        case 1:  return (double)(i % 100000) / 100;    /* prices */
+        case 2:  return 1.0 / (double)(i % 997 + 1);   /* long fractions */
+        default: return sqrt((double)i);               /* irrationals */
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 5000000;
+    double *nums = malloc(n * sizeof(double));
+    if (nums == NULL) return 1;
+    for (long i = 0; i < n; i++) nums[i] = sample(i);
+
+    size_t chars = 0;
+    double start = now();
+    for (long i = 0; i < n; i++) chars += strlen(old_num2str(nums[i]));
+    double old = (now() - start) * 1e9 / n;
+
+    char buf[FMT_LEN];
+    start = now();
+    for (long i = 0; i < n; i++) {
+        chars += format_num(buf, sizeof(buf), nums[i], TOT_DIGITS);
+    }
+    double fast = (now() - start) * 1e9 / n;
+
+    FormatArena arena;
+    format_arena_init(&arena);
+    start = now();
+    if (!format_bulk(&arena, nums, n, TOT_DIGITS, '\n')) return 1;
+    double bulk = (now() - start) * 1e9 / n;
+    chars += arena.len;
+    format_arena_free(&arena);
+
+    sink = (double)chars;
+    printf("probe loop   %8.1f ns/number\n", old);
+    printf("format_num   %8.1f ns/number (%.1fx)\n", fast, old / fast);
+    printf("format_bulk  %8.1f ns/number (%.1fx)\n", bulk, old / bulk);
+
+    free(nums);
+    return 0;
+}
@@ -0,0 +1,274 @@
+/********************** bench_gui.c *********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how long the calculator takes to handle a
+ * button press. The real window is built by calc.c's
+ * activate, and scripted key sequences are played by
+ * emitting "clicked" on its buttons. Each press is timed
+ * from the emission to the return of the action, and
+ * reported by kind of key. The display's label is only
+ * updated at the next frame, however many presses came
+ * before it, so display_str is timed on its own and the
+ * number of presses, label updates and frames is shown.
+ * Pending events are handled between presses, untimed.
+ * Last, a burst of keys is typed on the keyboard to show
+ * that it costs a single display update.
+ *
+ * Usage: xvfb-run -a bench/bench_gui [repetitions]
+ *
+ * Needs GTK and a display; xvfb-run provides a virtual
+ * one. The history tape is written to a temporary file
+ * which is removed afterwards.
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../display.h"
+
+/* Time spent in display_str, which calls calc_display_set_text */
+static GArray *display_times;
+
+static void probe_set_text(CalcDisplay *display, const char *text)
+{
+    double start = now();
+    calc_display_set_text(display, text);
+    double elapsed = now() - start;
+    g_array_append_val(display_times, elapsed);
+}
+
+#define calc_display_set_text probe_set_text
+#define main calc_main
+#include "../calc.c"
+#undef main
+#undef calc_display_set_text
+
+/* Enum representing the kinds of key timings are reported for */
+typedef enum {
+    KIND_DIGIT, KIND_BINARY, KIND_SPECIAL, KIND_POINT, KIND_CLEAR, KIND_COUNT
+} kind;
+
+static const char *kind_names[KIND_COUNT] = {
+    "digit", "binary", "special", "point", "clear"
+};
+
+/* A button of the real window */
+typedef struct Button {
+    GtkWidget *widget;
+    const char *label;
+    kind kind;
+} Button;
+
+/* Scripted key sequences, as button labels separated by spaces */
+static const struct { const char *name; const char *keys; } scripts[] = {
+    { "digit run",  "1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 "
+                    "1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 C" },
+    { "chained",    "1 2 + 3 4 × 5 - 6 ÷ 7 + 8 . 5 × 9 = C" },
+    { "unary",      "2 √x x² x³ sin cos tan +/- % ∛x "
+                    "5 x! 3 . 1 4 sin x² C" },
+};
+
+static Button buttons[32];
+static int nbuttons;
+
+/* Per-kind latencies, in seconds */
+static GArray *times[KIND_COUNT];
+
+/* Returns the kind of key a button presses, from the target of its
+ * "key" action */
+static kind kind_of(GtkWidget *button)
+{
+    GVariant *target =
+        gtk_actionable_get_action_target_value(GTK_ACTIONABLE(button));
+    key k = engine_char_key(g_variant_get_string(target, NULL)[0]);
+
+    if (k <= KEY_9) return KIND_DIGIT;
+    if (k == KEY_POINT) return KIND_POINT;
+    if (k <= KEY_EQUALS) return KIND_BINARY;
+    if (k <= KEY_TAN) return KIND_SPECIAL;
+    return KIND_CLEAR;
+}
+
+/* Finds the calculator's buttons among the grid's children, and those
+ * of the grids inside it */
+static void find_buttons(GtkWidget *grid)
+{
+    for (GtkWidget *child = gtk_widget_get_first_child(grid); child != NULL;
+         child = gtk_widget_get_next_sibling(child)) {
+        if (GTK_IS_GRID(child)) find_buttons(child);
+        if (!GTK_IS_BUTTON(child)) continue;
+
+        const char *label = gtk_button_get_label(GTK_BUTTON(child));
+        if (strcmp(label, "Off") == 0) continue;
+        if (nbuttons == (int)G_N_ELEMENTS(buttons)) break;
+        buttons[nbuttons].widget = child;
+        buttons[nbuttons].label = label;
+        buttons[nbuttons].kind = kind_of(child);
+        nbuttons++;
+    }
+}
+
+static Button *find_button(const char *label, size_t len)
+{
+    for (int i = 0; i < nbuttons; i++) {
+        if (strlen(buttons[i].label) == len &&
+            strncmp(buttons[i].label, label, len) == 0) {
+            return &buttons[i];
+        }
+    }
+    return NULL;
+}
+
+/* Handles whatever the last press left for the main loop to do */
+static void drain(void)
+{
+    while (g_main_context_iteration(NULL, FALSE)) {
+    }
+}
+
+/* Presses every key of a script, timing each press */
+static bool play(const char *keys)
+{
+    for (const char *key = keys; *key != '\0'; ) {
+        size_t len = strcspn(key, " ");
+        Button *button = find_button(key, len);
+        if (button == NULL) {
+            fprintf(stderr, "no button \"%.*s\"\n", (int)len, key);
+            return false;
+        }
+
+        double start = now();
+        g_signal_emit_by_name(button->widget, "clicked");
+        double elapsed = now() - start;
+        g_array_append_val(times[button->kind], elapsed);
+
+        drain();
+        key += len;
+        while (*key == ' ') key++;
+    }
+    return true;
+}
+
+/* Types a burst of keys on the keyboard faster than frames are drawn,
+ * as auto-repeat or a script would. Each key is timed; the display should
+ * be updated once for the whole burst. Returns the number of updates. */
+static unsigned type_burst(Data *data, const char *keys, GArray *samples)
+{
+    unsigned before = display_times->len;
+
+    for (const char *c = keys; *c != '\0'; c++) {
+        double start = now();
+        key_pressed(NULL, (guint)*c, 0, 0, data);
+        double elapsed = now() - start;
+        g_array_append_val(samples, elapsed);
+    }
+
+    /* wait for the frame that shows the burst */
+    while (data->tick != 0) g_main_context_iteration(NULL, TRUE);
+    return display_times->len - before;
+}
+
+/* Prints percentiles of samples, in microseconds */
+static void report(const char *name, GArray *samples)
+{
+    report_percentiles(name, (double *)samples->data, samples->len, 1e6);
+}
+
+static long repetitions;
+static int status;
+
+/* Builds the calculator's window, then runs the scripts and quits */
+static void run(GtkApplication *app, gpointer user_data)
+{
+    Data *data = (Data *)user_data;
+    activate(app, data);
+
+    /* the scripts use the scientific keys too */
+    GtkWidget *window = GTK_WIDGET(gtk_application_get_active_window(app));
+    g_action_group_change_action_state(G_ACTION_GROUP(window), "scientific",
+                                       g_variant_new_boolean(TRUE));
+    drain();
+
+    find_buttons(gtk_widget_get_ancestor(data->f, GTK_TYPE_GRID));
+
+    /* the first pass warms caches and is not counted */
+    for (long r = -1; r < repetitions && status == 0; r++) {
+        for (size_t s = 0; s < G_N_ELEMENTS(scripts); s++) {
+            if (!play(scripts[s].keys)) status = 1;
+        }
+        if (r < 0) {
+            for (int k = 0; k < KIND_COUNT; k++) g_array_set_size(times[k], 0);
+            g_array_set_size(display_times, 0);
+            data->changes = data->updates = data->frames = 0;
+        }
+    }
+
+    /* wait for the frame showing the last press */
+    while (data->tick != 0) g_main_context_iteration(NULL, TRUE);
+
+    report_heading("key", "us");
+    for (int k = 0; k < KIND_COUNT; k++) report(kind_names[k], times[k]);
+    report("display_str", display_times);
+    printf("%lu presses, %lu label updates, %lu frames\n", data->changes,
+           data->updates, data->frames);
+
+    /* keyboard input is coalesced to one display update per frame */
+    static const char burst[] = "12345678901234567890+98765432109876543210=";
+    GArray *typed = g_array_new(FALSE, FALSE, sizeof(double));
+    unsigned updates = type_burst(data, burst, typed);
+    report("typed key", typed);
+    printf("%zu typed keys, %u display update%s\n", strlen(burst), updates,
+           updates == 1 ? "" : "s");
+    g_array_free(typed, TRUE);
+
+    g_application_quit(G_APPLICATION(app));
+}
+
+int main(int argc, char *argv[])
+{
+    repetitions = (argc > 1) ? atol(argv[1]) : 200;
+
+    for (int c = 0; c < KIND_COUNT; c++) {
+        times[c] = g_array_new(FALSE, FALSE, sizeof(double));
+    }
+    display_times = g_array_new(FALSE, FALSE, sizeof(double));
+
+    Data *data = (Data *)malloc(sizeof(struct Data));
+    data->engine = engine_new();
+    data->f = NULL;
+    data->sci = NULL;
+    data->tick = 0;
+    data->import = NULL;
+    data->progress = 0;
+    data->progress_tick = 0;
+    data->changes = data->updates = data->frames = 0;
+
+    /* a fresh history each run keeps runs alike */
+    char *path = g_strdup_printf("%s/bench_gui_history.%d", g_get_tmp_dir(),
+                                 (int)getpid());
+    unlink(path);
+    data->history = history_open(path);
+    data->tape = NULL;
+    if (data->history != NULL) {
+        data->tape = calc_tape_new(data->history);
+        engine_set_hook(data->engine, record, data);
+    }
+
+    GtkApplication *app = gtk_application_new("com.example.BenchGui",
+                                              G_APPLICATION_NON_UNIQUE);
+    g_signal_connect(app, "activate", G_CALLBACK(run), data);
+    g_application_run(G_APPLICATION(app), 0, NULL);
+
+    g_clear_object(&app);
+    engine_free(data->engine);
+    g_clear_object(&data->tape);
+    history_close(data->history);
+    unlink(path);
+    g_free(path);
+    free(data);
+    return status;
+}
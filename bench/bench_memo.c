@@ -0,0 +1,88 @@
+/********************* bench_memo.c *********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how long one unary operation takes when it is
+ * computed directly with un_op and when it goes through a
+ * memo cache, for arguments that repeat at various rates.
+ *
+ * Usage: bench_memo [operations per test]
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../memo.h"
+
+/* Distinct arguments that repeat, such as the numbers in a batch of
+ * similar expressions */
+#define COMMON 256
+
+/* Fills args with n arguments, of which about rate percent are drawn from
+ * COMMON values and the rest are all different */
+static void fill(double *args, long n, int rate)
+{
+    unsigned long seed = 42;
+
+    for (long i = 0; i < n; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        unsigned long r = seed >> 33;
+
+        if ((long)(r % 100) < rate) {
+            args[i] = (double)(r / 100 % COMMON) / 4;
+        } else {
+            args[i] = 100 + (double)i / 7;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 2000000;
+    static const int rates[] = { 0, 50, 90, 99 };
+    static const struct { special op; const char *name; } ops[] = {
+        { FAC, "factorial" }, { CBT, "cbrt" }, { SIN, "sin" }, { TAN, "tan" }
+    };
+    double *args = malloc(n * sizeof(double));
+    MemoCache *cache = malloc(sizeof(MemoCache));
+    if (args == NULL || cache == NULL) return 1;
+
+    printf("cache: %d results, %zu bytes\n", MEMO_SLOTS, sizeof(MemoCache));
+    printf("%-10s %6s %10s %10s %8s %8s\n", "operation", "repeat",
+           "un_op ns", "memo ns", "hits", "speedup");
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(*rates); r++) {
+        fill(args, n, rates[r]);
+
+        for (size_t o = 0; o < sizeof(ops) / sizeof(*ops); o++) {
+            special op = ops[o].op;
+            double total = 0, memo_total = 0;
+
+            double start = now();
+            for (long i = 0; i < n; i++) total += un_op(args[i], op);
+            double direct = (now() - start) * 1e9 / n;
+
+            memo_init(cache);
+            start = now();
+            for (long i = 0; i < n; i++) {
+                memo_total += memo_un_op(cache, args[i], op);
+            }
+            double memo = (now() - start) * 1e9 / n;
+
+            if (memcmp(&total, &memo_total, sizeof(total)) != 0) {
+                fprintf(stderr, "%s: results differ\n", ops[o].name);
+                return 1;
+            }
+            sink = total;
+
+            printf("%-10s %5d%% %10.2f %10.2f %7.1f%% %7.2fx\n",
+                   ops[o].name, rates[r], direct, memo,
+                   100.0 * cache->hits / n, direct / memo);
+        }
+    }
+
+    free(cache);
+    free(args);
+    return 0;
+}
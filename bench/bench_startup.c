@@ -0,0 +1,133 @@
+/******************** bench_startup.c *******************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how long the calculator takes from being
+ * launched to its first frame on screen. The binary is
+ * launched repeatedly with CALC_STARTUP_TRACE=exit, so it
+ * prints its startup milestones and quits after the first
+ * frame; CALC_STARTUP_T0 makes the milestones count from
+ * just before the launch. The number of widgets in the
+ * window at its first frame is reported too.
+ *
+ * Usage: xvfb-run -a bench/bench_startup [launches]
+ *            [calc [ARG...]]
+ *
+ * For example, compare basic and scientific mode with
+ *   bench/bench_startup 50 ./calc
+ *   bench/bench_startup 50 ./calc --scientific
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+/* Milestones printed by the calculator, in order */
+static const char *milestones[] = {
+    "main", "g_application_run", "activate entry", "activate exit",
+    "first frame"
+};
+#define MILESTONES (sizeof(milestones) / sizeof(*milestones))
+
+/* Launches argv[0] with arguments argv once, storing the time of each
+ * milestone in ms in times and the number of widgets in widgets. Returns
+ * false if the launch failed or the first frame was not reached. */
+static bool launch(char **argv, double *times, int *widgets)
+{
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+
+    /* the environment, plus the two variables that turn tracing on */
+    size_t n = 0;
+    while (environ[n] != NULL) n++;
+    char **env = malloc((n + 3) * sizeof(char *));
+    if (env == NULL) return false;
+    memcpy(env, environ, n * sizeof(char *));
+
+    char t0[64];
+    env[n] = "CALC_STARTUP_TRACE=exit";
+    env[n + 1] = t0;
+    env[n + 2] = NULL;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+
+    pid_t pid;
+    snprintf(t0, sizeof(t0), "CALC_STARTUP_T0=%lld",
+             (long long)(now() * 1e6));
+    int error = posix_spawn(&pid, argv[0], &actions, NULL, argv, env);
+
+    posix_spawn_file_actions_destroy(&actions);
+    free(env);
+    close(fds[1]);
+    if (error != 0) {
+        close(fds[0]);
+        return false;
+    }
+
+    for (size_t i = 0; i < MILESTONES; i++) times[i] = -1;
+
+    /* read the milestones as they are printed */
+    FILE *trace = fdopen(fds[0], "r");
+    char line[256];
+    while (trace != NULL && fgets(line, sizeof(line), trace) != NULL) {
+        if (strncmp(line, "startup: ", 9) != 0) continue;
+        if (strncmp(line + 9, "widgets ", 8) == 0) {
+            *widgets = atoi(line + 17);
+        }
+
+        for (size_t i = 0; i < MILESTONES; i++) {
+            size_t len = strlen(milestones[i]);
+            if (strncmp(line + 9, milestones[i], len) == 0 &&
+                line[9 + len] == ' ') {
+                times[i] = atof(line + 9 + len);
+            }
+        }
+    }
+    if (trace != NULL) fclose(trace);
+
+    int status;
+    waitpid(pid, &status, 0);
+    return times[MILESTONES - 1] >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 50;
+    char *calc_argv[] = { "./calc", NULL };
+    char **calc = (argc > 2) ? argv + 2 : calc_argv;
+    int widgets = 0;
+    double *times = malloc(n * MILESTONES * sizeof(double));
+    double *column = malloc(n * sizeof(double));
+    if (n <= 0 || times == NULL || column == NULL) return 1;
+
+    for (long i = 0; i < n; i++) {
+        if (!launch(calc, times + i * MILESTONES, &widgets)) {
+            fprintf(stderr, "%s did not print a first frame; it could not "
+                    "be run, there is no display, or it does not trace "
+                    "startup and handed its launch to a running "
+                    "calculator\n", calc[0]);
+            return 1;
+        }
+    }
+
+    report_heading("milestone", "ms");
+    for (size_t m = 0; m < MILESTONES; m++) {
+        for (long i = 0; i < n; i++) column[i] = times[i * MILESTONES + m];
+        report_percentiles(milestones[m], column, n, 1);
+    }
+    printf("%-22s %8d\n", "widgets", widgets);
+
+    free(times);
+    free(column);
+    return 0;
+}
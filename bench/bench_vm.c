@@ -0,0 +1,70 @@
+/********************** bench_vm.c **********************
+ * Author: Jeremy Lawrence
+ *
+ * Measures how long one evaluation of a compiled program
+ * takes with the macro-based evaluator (expr_eval) and
+ * with the threaded virtual machine (vm_eval).
+ *
+ * Usage: bench_vm [evaluations per expression]
+ *
+ *******************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../expr.h"
+#include "../vm.h"
+
+/* Expressions exercising arithmetic, unary operations and both mixed */
+static const char *expressions[] = {
+    "2 + 3 × 4 - 5 ÷ 6",
+    "((1 + 2) × (3 + 4) - (5 + 6) × (7 - 8)) ÷ 9 + 10 × 11 - 12",
+    "-3² + 4³ - 50% × 8 + 1.5 × 2.5 ÷ 0.5",
+    "√2 + ∛3 + 5! - sin 1 + cos 2 × tan 3",
+};
+
+/* Evaluates prog n times with eval, returning nanoseconds per evaluation */
+static double time_eval(double (*eval)(const Program *, double),
+                        const Program *prog, long n)
+{
+    double total = 0;
+    double start = now();
+
+    for (long i = 0; i < n; i++) total += eval(prog, i);
+
+    double elapsed = now() - start;
+    sink = total;
+    return elapsed * 1e9 / n;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 10000000;
+
+    printf("%-60s %10s %10s %8s\n", "expression", "macro ns", "vm ns",
+           "speedup");
+
+    for (size_t i = 0; i < sizeof(expressions) / sizeof(*expressions); i++) {
+        Program prog;
+        ExprError error;
+
+        if (!expr_compile(&prog, expressions[i], strlen(expressions[i]),
+                          &error)) {
+            fprintf(stderr, "%s: %s\n", expressions[i], error.msg);
+            return 1;
+        }
+
+        if (expr_eval(&prog, 0) != vm_eval(&prog, 0)) {
+            fprintf(stderr, "%s: evaluators disagree\n", expressions[i]);
+            return 1;
+        }
+
+        double macro = time_eval(expr_eval, &prog, n);
+        double vm = time_eval(vm_eval, &prog, n);
+
+        printf("%-60s %10.2f %10.2f %7.2fx\n", expressions[i], macro, vm,
+               macro / vm);
+    }
+
+    return 0;
+}
@@ -1,379 +1,557 @@
 /************************ calc.c ************************
  * Author: Jeremy Lawrence
  * 
- * This file contains the implementation of a calculator.
+ * This file contains the GTK user interface of a calculator.
+ * The arithmetic itself is done by the engine in engine.c.
  * In order to run this program, GTK4 must be downloaded.
  * This can be downloaded at https://www.gtk.org/
  * 
  *******************************************************/
 
 #include <gtk/gtk.h> /* GTK Toolkit (version 4 required) */
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 #include <stdbool.h>
-
-/* Constants defining floating point precision */
-#define TOL 0.0000001
-#define TOT_DIGITS 12
-#define MAX_PRECISION 7
-
-#define pi 3.141592654
-
-/* Enum representing binary operations, and default (no operation) */
-typedef enum {
-    DIV, MUL, ADD, SUB, DEFAULT
-} operator;
-
-/* Performs binary operation on a and b */
-#define bin_op(a, op, b) \
-    (((op) == DIV) ? ((a) / (b)) : \
-     ((op) == MUL) ? ((a) * (b)) : \
-     ((op) == ADD) ? ((a) + (b)) : \
-     ((op) == SUB) ? ((a) - (b)) : b)
-
-/* Given an operator, returns the ASCII character representing it, as a
- * string, or the string "\0" if the operator is invalid or DEFAULT */
-#define op_to_str(op) \
-    (((op) == DIV) ? ("÷") : \
-     ((op) == MUL) ? ("\u00D7") : \
-     ((op) == ADD) ? ("+") : \
-     ((op) == SUB) ? ("-") : "\0")
-
-/* Given a string, returns the operator it represents. If the string
- * does not represent an operator, returns the default operator */
-#define str_to_op(str) \
-    ((strcmp((str), ("÷")) == 0) ? (DIV) : \
-     (strcmp((str), ("\u00D7")) == 0) ? (MUL) : \
-     (strcmp((str), ("+")) == 0) ? (ADD) : \
-     (strcmp((str), ("-")) == 0) ? (SUB) : DEFAULT)
-
-/* Enum representing special unary operations */
-typedef enum {
-    FAC, SQT, CBT, SGN, PCT, SQR, CUB, SIN, COS, TAN, NUL
-} special;
-
-/* Performs binary operation on a and b */
-#define un_op(a, op) \
-    (((op) == FAC) ? (tgamma((a) + 1)) : \
-     ((op) == SQT) ? (sqrt(a)) : \
-     ((op) == CBT) ? (cbrt(a)) : \
-     ((op) == SGN) ? (0 - (a)) : \
-     ((op) == PCT) ? ((a) / (float)100) : \
-     ((op) == SQR) ? ((a) * (a)) : \
-     ((op) == CUB) ? ((a) * (a) * (a)) : \
-     ((op) == SIN) ? (sin(a)) : \
-     ((op) == COS) ? (cos(a)) : \
-     ((op) == TAN) ? (tan(a)) : 0)
-
-#define str_to_special(str) \
-    ((strcmp((str), ("x!")) == 0) ? (FAC) : \
-     (strcmp((str), ("\u221Ax")) == 0) ? (SQT) : \
-     (strcmp((str), ("\u221Bx")) == 0) ? (CBT) : \
-     (strcmp((str), ("+/-")) == 0) ? (SGN) : \
-     (strcmp((str), ("%")) == 0) ? (PCT) : \
-     (strcmp((str), ("x²")) == 0) ? (SQR) : \
-     (strcmp((str), ("x³")) == 0) ? (CUB) : \
-     (strcmp((str), ("sin")) == 0) ? (SIN) : \
-     (strcmp((str), ("cos")) == 0) ? (COS) : \
-    (strcmp((str), ("tan")) == 0) ? (TAN) : NUL)
-     
-
-/* Object storing information about the calculator's current state */
+#include <errno.h>
+#include <time.h>
+#include "engine.h"  /* GTK-free calculator engine */
+#include "expr.h"    /* Compiler for expressions given with -e */
+#include "format.h"  /* Formatting of their results */
+#include "vm.h"      /* Evaluation of compiled expressions */
+#include "batch.h"   /* Evaluation of expressions without a GUI */
+#include "history.h" /* History tape kept in a file between runs */
+#include "tape.h"    /* List model and view of the history tape */
+#include "startup.h" /* Startup milestones, printed if asked for */
+#include "display.h" /* Widget showing the display's text */
+#include "import.h"  /* Evaluation of files on a worker thread */
+
+/* Object storing the GUI's state */
 typedef struct Data {
-    /* Is true if calculator is in decimal fraction input mode, for
-     * example when the user is entering 2.55. False otherwise. */
-    bool decimal;
-
-    /* In decimal fraction input mode, this holds the number of digits after
-     * the decimal point. Is used to display the correct number digits. This
-     * number is zero if not in decimal fraction input mode. */
-    int decimals;
-
-    /* Current operation being performed. For example, if the user inputs
-     * "2 + 2 =", then op = DEFAULT until "+" is pressed, at which point
-     * op = ADD until "=" is entered. */
-    operator op;
-
-    double num;    /* Stores the current number being entered */
-    double result; /* Result of operations since the last "Clear" or "=" */
-
-    GtkWidget *f;  /* Frame object acting as calculator's display screen */
+    Engine *engine;   /* Calculator engine holding all arithmetic state */
+    GtkWidget *f;     /* CalcDisplay acting as calculator's display screen */
+    GtkWidget *sci;   /* Scientific keys, or NULL until first shown */
+    History *history; /* History file, or NULL if it could not be opened */
+    CalcTape *tape;   /* List model of history, or NULL without one */
+    guint tick;       /* Pending display update, or 0 */
+
+    /* Import running, which cancelling stops, or NULL; its progress in
+     * thousandths, set by its worker thread; and the tick callback
+     * showing that progress on the display, or 0 */
+    GCancellable *import;
+    gint progress;
+    guint progress_tick;
+
+    /* Display counters: changes asked for, label updates made and frames
+     * painted. Setting CALC_DISPLAY_STATS prints them at exit. */
+    unsigned long changes, updates, frames;
 } Data;
 
 /* Displays given string on calculator using more concise syntax */
-static void display_str(Data *data, char *display)
+static void display_str(Data *data, const char *display)
 {
-    gtk_frame_set_label(GTK_FRAME(data->f), (const char *)display);
+    calc_display_set_text(CALC_DISPLAY(data->f), display);
 }
 
-/* Gets the string from the calculator display */
-static char *get_display(Data *data)
+/* Displays the engine's current display text on the calculator's screen */
+static void display_num(Data *data)
 {
-    return (char *)gtk_frame_get_label(GTK_FRAME(data->f));
+    display_str(data, engine_display(data->engine));
 }
 
-/* Converts double to string given number of digits of precision. */
-static char *precise_num2str(double num, int precision)
+/* Tick callback updating the display once per frame for any number of
+ * changes since the last one */
+static gboolean display_tick(GtkWidget *widget, GdkFrameClock *clock,
+                             gpointer user_data)
 {
-    static char buffer[TOT_DIGITS + 1]; /* reusable static buffer */
-    snprintf(buffer, sizeof(buffer), "%.*f", precision, num);
-    return buffer;
+    (void)widget;
+    (void)clock;
+
+    Data *data = (Data *)user_data;
+    data->tick = 0;
+    data->updates++;
+    display_num(data);
+    return G_SOURCE_REMOVE;
 }
 
-/* Creates a string representation of the given number */
-static char *num2str(double num, bool decimal, int decimals)
+/* Marks the display as out of date. Its label is updated at the next
+ * frame, once however many changes come before it, so that bursts of
+ * input cost one relayout per frame. */
+static void queue_display(Data *data)
 {
-    if (decimal) return precise_num2str(num, decimals);
-    if (num == 0) return precise_num2str(0, 0); 
-
-    /* num can be displayed with 0-7 digits of precision */
-    for (int i = 0; i <= MAX_PRECISION; i++) {
+    if (data->f == NULL) return;
 
-        /* round to i digits after decimal point */
-        double factor = pow(10, i);
-        int shifted = round(num * factor);
-        double rounded = (double)shifted / factor;
-
-        /* check whether num is close to rounded counterpart */
-        if (fabs(num - rounded) < TOL) {
-            return precise_num2str(rounded, i);
-        }
+    data->changes++;
+    if (data->tick == 0) {
+        data->tick = gtk_widget_add_tick_callback(data->f, display_tick,
+                                                  data, NULL);
     }
-
-    int int_part = (int)num;
-    /* number of digits before the decimal point */
-    int int_digits = (int_part == 0) ? 0 : ceil(log10(abs(int_part)));
-
-    /* handle large numbers or high precision */
-    int precision = TOT_DIGITS - int_digits;
-    if (precision < 0) precision = 0;
-    return precise_num2str(num, precision);
-}
-
-/* Displays a given number on the calculator's screen. */
-static void display_num(Data *data)
-{
-    char *num_displayed = num2str(data->num, data->decimal, data->decimals);
-    display_str(data, num_displayed);
 }
 
-/* Handles numerical input into calculator */
-static void entering(GtkWidget *widget, gpointer user_data)
+/* Feeds a key to the engine. While a file is being imported the display
+ * shows its progress, and the only key taken is "C", which cancels it. */
+static void handle_key(Data *data, key k)
 {
-    Data *data = (Data *)user_data;
-    char *prev = get_display(data); /* previous display */
-    char *button_label = (char *)gtk_button_get_label(GTK_BUTTON(widget));
-    double entered_num = strtof(button_label, NULL);
-
-    /* if previous display shows an operator */
-    if (str_to_op(prev) != DEFAULT) {
-        display_str(data, button_label);
-        data->num = entered_num;
+    if (data->import != NULL) {
+        if (k == KEY_CLEAR) g_cancellable_cancel(data->import);
         return;
     }
 
-    /* ignore leading zeros */
-    if (strcmp(prev, "0") == 0 && entered_num == 0) {
-        data->num = 0;
-        return;
-    }
+    engine_key(data->engine, k);
+    queue_display(data);
+}
 
-    /* if previous display shows inf or nan */
-    if (strcmp(prev, "inf") == 0 || strcmp(prev, "nan") == 0) {
-        display_str(data, button_label);
-        data->num = 0;
-        data->result = 0;
-    }
+/* Handles every key of the calculator. The parameter is the character
+ * engine_char_key maps to the key, so the keys in calc.ui, the keyboard
+ * and batch replays all share one table. */
+static void press(GSimpleAction *action, GVariant *parameter,
+                  gpointer user_data)
+{
+    (void)action;
+
+    Data *data = (Data *)user_data;
+    const char *c = g_variant_get_string(parameter, NULL);
 
-    /* handle decimal fraction input mode */
-    if (data->decimal) {
-        data->decimals++;
-        double factor = pow(10, data->decimals);
+    handle_key(data, engine_char_key(c[0]));
+}
 
-        if (data->num < 0) { /* negative decimal */
-            data->num -= (entered_num / factor);
-        } else {
-            data->num += (entered_num / factor);
-        }
+/* Returns the key for a key on the keyboard, or KEY_NONE. Characters are
+ * mapped by engine_char_key, as buttons are; F1 to F8 are the scientific
+ * keys in the order they are laid out. */
+static key keyval_key(guint keyval)
+{
+    static const char function_keys[] = "rRqQ!sct";
+
+    switch (keyval) {
+        case GDK_KEY_Return:
+        case GDK_KEY_KP_Enter:     return KEY_EQUALS;
+        case GDK_KEY_BackSpace:    return KEY_BACK;
+        case GDK_KEY_Escape:
+        case GDK_KEY_Delete:       return KEY_CLEAR;
+        case GDK_KEY_comma:
+        case GDK_KEY_KP_Separator: return KEY_POINT;
+        default:                   break;
     }
-    else { /* append entered digit to the displayed integer */
-        data->num = data->num * 10 + entered_num;
+    if (keyval >= GDK_KEY_F1 && keyval <= GDK_KEY_F8) {
+        return engine_char_key(function_keys[keyval - GDK_KEY_F1]);
     }
 
-    display_num(data);
+    gunichar c = gdk_keyval_to_unicode(keyval);
+    return (c > 0 && c < 128) ? engine_char_key((char)c) : KEY_NONE;
 }
 
-/* Handles unary operator inputs */
-static void special_op(GtkWidget *widget, gpointer user_data)
+/* Handles a key typed on the keyboard. Like buttons, typed keys only
+ * mark the display out of date, so that auto-repeat and fast or scripted
+ * typing do not queue a redraw per key. */
+static gboolean key_pressed(GtkEventControllerKey *controller, guint keyval,
+                            guint keycode, GdkModifierType state,
+                            gpointer user_data)
 {
-    char *button_label = (char *)gtk_button_get_label(GTK_BUTTON(widget));
-    special op = str_to_special(button_label);
+    (void)controller;
+    (void)keycode;
 
     Data *data = (Data *)user_data;
-    data->decimal = false; /* exit decimal fraction input mode */
-    data->decimals = 0;
-
-    char *prev_num = get_display(data);
+    key k = keyval_key(keyval);
 
-    /* this button is ignored if an operation is being performed */
-    if (str_to_op(prev_num) == DEFAULT) {
-        data->num = un_op(data->num, op);
-        display_num(data);
+    /* leave shortcuts such as Ctrl+Q to the application */
+    if (k == KEY_NONE || (state & (GDK_CONTROL_MASK | GDK_ALT_MASK))) {
+        return FALSE;
     }
+
+    handle_key(data, k);
+    return TRUE;
 }
 
-/* Handles the (.) button */
-static void point(GtkWidget *widget, gpointer user_data)
+/* Switches between basic and scientific mode. The scientific keys are
+ * only built the first time scientific mode is opened, and are hidden
+ * rather than destroyed when it is left. */
+static void set_scientific(GSimpleAction *action, GVariant *state,
+                           gpointer user_data)
 {
     Data *data = (Data *)user_data;
+    bool on = g_variant_get_boolean(state);
+
+    g_simple_action_set_state(action, state);
+
+    if (on && data->sci == NULL) {
+        GtkBuilder *builder =
+            gtk_builder_new_from_resource("/com/example/calc/scientific.ui");
+        data->sci =
+            GTK_WIDGET(gtk_builder_get_object(builder, "scientific"));
+        gtk_grid_attach(GTK_GRID(gtk_widget_get_ancestor(data->f,
+                                                         GTK_TYPE_GRID)),
+                        data->sci, 0, 1, 4, 2);
+        g_object_unref(builder);
+    }
+    if (data->sci != NULL) {
+        gtk_widget_set_visible(data->sci, on);
+    }
+}
 
-    /* ignore repeated decimal points */
-    if (data->decimal) return;
+/* Actions added to the calculator window, named as in calc.ui */
+static const GActionEntry actions[] = {
+    { .name = "key", .activate = press, .parameter_type = "s" },
+    { .name = "scientific", .state = "false", .change_state = set_scientific }
+};
 
-    char *prev_num = get_display(data);
+/* Called by the engine after each binary operation; records it in the
+ * history file and on the tape */
+static void record(void *user_data, double left, operator op, double right,
+                   double result)
+{
+    Data *data = (Data *)user_data;
+    HistoryEntry entry = { left, right, result, (int64_t)time(NULL), op, 0 };
 
-    /* if a binary operation is not being performed */
-    if (str_to_op(prev_num) == DEFAULT) {
-        strcat(prev_num, ".");
-        data->decimal = true;
-        display_str(data, prev_num);
-    }
+    history_append(data->history, &entry);
+    calc_tape_update(data->tape);
 }
 
-/* Handles binary operator inputs, as well as "=".
- * Note: Division by zero results in "inf" */
-static void binary_op(GtkWidget *widget, gpointer user_data)
+/* Counts the frames the window paints */
+static void count_frame(GdkFrameClock *clock, gpointer user_data)
 {
-    char *button_label = (char *)gtk_button_get_label(GTK_BUTTON(widget));
-    operator op = str_to_op(button_label);
+    (void)clock;
 
-    /* do nothing if no operation is being performed, i.e. if user enters
-     * an expression with no binary operation, such as "3 =" */
-    if (op == DEFAULT && strcmp(button_label, "=") != 0) {
-        return;
-    }
+    ((Data *)user_data)->frames++;
+}
+
+/* Tick callback showing an import's progress once per frame, however
+ * often its worker thread updates it */
+static gboolean show_progress(GtkWidget *widget, GdkFrameClock *clock,
+                              gpointer user_data)
+{
+    (void)widget;
+    (void)clock;
 
     Data *data = (Data *)user_data;
-    data->decimal = false; /* exit decimal fraction input mode */
-    data->decimals = 0;
-
-    /* evaluate stored expression */
-    data->result = bin_op(data->result, data->op, data->num);
-    data->op = op;
-
-    /* if "=" was entered, display result */
-    if (op == DEFAULT) {
-        data->num = data->result;
-        display_num(data);
-        data->result = 0;
-        return;
-    }
+    char text[32];
 
-    display_str(data, op_to_str(op));
+    snprintf(text, sizeof(text), "Importing %d%%",
+             g_atomic_int_get(&data->progress) / 10);
+    display_str(data, text);
+    return G_SOURCE_CONTINUE;
 }
 
-/* Clears and resets the calculator */
-static void clear(GtkWidget *widget, gpointer user_data)
+/* The display goes with the window. An import still running is
+ * cancelled; its outcome is still printed on its command line. */
+static void window_destroyed(GtkWidget *window, gpointer user_data)
 {
+    (void)window;
+
     Data *data = (Data *)user_data;
-    
-    data->decimal = false;
-    data->decimals = 0;
-    data->op = DEFAULT;
-    data->result = 0;
-    data->num = 0;
-
-    display_str(data, "0");
-}
 
-/* Creates a 1×1 button at coordinate (x,y) and adds to grid */
-static void new_button(GtkWidget *grid, char *label, void *callback,
-                       gpointer data, int x, int y)
-{
-    GtkWidget *button = gtk_button_new_with_label(label);
-    g_signal_connect(button, "clicked", G_CALLBACK(callback), data);
-    gtk_grid_attach(GTK_GRID(grid), button, x, y, 1, 1);
+    if (data->import != NULL) g_cancellable_cancel(data->import);
+    data->f = NULL;
+    data->sci = NULL;
+    data->tick = data->progress_tick = 0;
 }
 
 /* Callback for the "activate" signal; creates calculator */
 static void activate(GtkApplication *app, gpointer user_data)
 {
+    startup_mark("activate entry");
+
+    /* if the calculator is already open, raise its window */
+    GtkWindow *open_window = gtk_application_get_active_window(app);
+    if (open_window != NULL) {
+        gtk_window_present(open_window);
+        startup_mark("activate exit");
+        return;
+    }
+
     /* create a new window */
     GtkWidget *window = gtk_application_window_new(app);
+    startup_watch(window);
+    startup_on_frame(window, G_CALLBACK(count_frame), user_data);
+    g_signal_connect(window, "destroy", G_CALLBACK(window_destroyed),
+                     user_data);
     gtk_window_set_title(GTK_WINDOW(window), "Calculator");
     gtk_window_set_default_size(GTK_WINDOW(window), 400, 400);
 
-    /* create grid to contain buttons and display screen */
-    GtkWidget *grid = gtk_grid_new();
+    /* build the basic buttons and display screen from calc.ui, compiled
+     * into the binary; its buttons activate the actions added here, and
+     * "Off" activates the window's own "close" action. The display's
+     * type must be registered before the builder meets it. */
+    g_action_map_add_action_entries(G_ACTION_MAP(window), actions,
+                                    G_N_ELEMENTS(actions), user_data);
+    g_type_ensure(CALC_TYPE_DISPLAY);
+    GtkBuilder *builder =
+        gtk_builder_new_from_resource("/com/example/calc/calc.ui");
+    GtkWidget *grid = GTK_WIDGET(gtk_builder_get_object(builder, "grid"));
+    ((Data *)user_data)->f =
+        GTK_WIDGET(gtk_builder_get_object(builder, "display"));
+    gtk_window_set_titlebar(GTK_WINDOW(window),
+                    GTK_WIDGET(gtk_builder_get_object(builder, "titlebar")));
     gtk_window_set_child(GTK_WINDOW(window), grid);
+    g_object_unref(builder);
 
-    /* create display screen */
-    GtkWidget *frame = gtk_frame_new("0");
-    ((Data *)user_data)->f = frame;
-    gtk_frame_set_label_align(GTK_FRAME(frame), 1);
-    gtk_grid_attach(GTK_GRID(grid), frame, 0, 0, 4, 1);
-
-    /* create buttons for numbers 0-9 */
-    new_button(grid, "0", entering, user_data, 1, 7);
-    char label[] = "1";
-    for (int i = 6; i > 3; i--) {
-        for (int j = 0; j < 3; j++) {
-            new_button(grid, label, entering, user_data, j, i);
-            label[0]++;
-        }
+    /* an import outlives a closed window until its thread sees it was
+     * cancelled; a window opened meanwhile shows it until it ends */
+    Data *data = (Data *)user_data;
+    if (data->import != NULL) {
+        data->progress_tick = gtk_widget_add_tick_callback(data->f,
+                                                           show_progress,
+                                                           data, NULL);
     }
 
-    /* create non-numerical buttons */
-    new_button(grid, "\u221Ax", special_op, user_data, 0, 1);
-    new_button(grid, "\u221Bx", special_op, user_data, 1, 1);
-    new_button(grid, "x²", special_op, user_data, 2, 1);
-    new_button(grid, "x³", special_op, user_data, 3, 1);
-    new_button(grid, "x!", special_op, user_data, 0, 2);
-    new_button(grid, "sin", special_op, user_data, 1, 2);
-    new_button(grid, "cos", special_op, user_data, 2, 2);
-    new_button(grid, "tan", special_op, user_data, 3, 2);
-    new_button(grid, "C", clear, user_data, 0, 3);
-    new_button(grid, "+/-", special_op, user_data, 1, 3);
-    new_button(grid, "%", special_op, user_data, 2, 3);
-    new_button(grid, ".", point, user_data, 2, 7);
-    new_button(grid, "÷", binary_op, user_data, 3, 3);
-    new_button(grid, "\u00D7", binary_op, user_data, 3, 4);
-    new_button(grid, "-", binary_op, user_data, 3, 5);
-    new_button(grid, "+", binary_op, user_data, 3, 6);
-    new_button(grid, "=", binary_op, user_data, 3, 7);
-
-    /* create "Off" button, which exits window */
-    GtkWidget *button = gtk_button_new_with_label("Off");
-    g_signal_connect_swapped(button, "clicked", G_CALLBACK(gtk_window_destroy),
-                                                                       window);
-    gtk_grid_attach(GTK_GRID(grid), button, 0, 7, 1, 1);
+    /* take typed keys before the focused button does, so that Enter is
+     * "=" rather than a click */
+    GtkEventController *keys = gtk_event_controller_key_new();
+    gtk_event_controller_set_propagation_phase(keys, GTK_PHASE_CAPTURE);
+    g_signal_connect(keys, "key-pressed", G_CALLBACK(key_pressed),
+                     user_data);
+    gtk_widget_add_controller(window, keys);
+
+    /* create history tape below the buttons; only the rows in sight are
+     * ever read from the file */
+    if (data->tape != NULL) {
+        GtkWidget *tape = calc_tape_view_new(data->tape);
+        gtk_widget_set_size_request(tape, -1, 120);
+        gtk_grid_attach(GTK_GRID(grid), tape, 0, 8, 4, 1);
+    }
 
     /* present the window */
     gtk_window_present(GTK_WINDOW(window));
+    startup_mark("activate exit");
+}
+
+/* Callback for the "startup" signal, which only the first calculator
+ * started receives; opens the history file, kept in the user's data
+ * directory */
+static void open_history(GApplication *app, gpointer user_data)
+{
+    (void)app;
+
+    Data *data = (Data *)user_data;
+    char *dir = g_build_filename(g_get_user_data_dir(), "gtkalculator", NULL);
+    char *path = g_build_filename(dir, "history", NULL);
+
+    g_mkdir_with_parents(dir, 0755);
+    data->history = history_open(path);
+    if (data->history != NULL) {
+        data->tape = calc_tape_new(data->history);
+        engine_set_hook(data->engine, record, data);
+    } else if (errno == EBUSY) {
+        /* without a session bus every calc is its own first instance */
+        g_printerr("calc: %s: in use by another calculator; "
+                   "running without history\n", path);
+    } else {
+        g_printerr("calc: %s: %s\n", path, g_strerror(errno));
+    }
+
+    g_free(path);
+    g_free(dir);
+}
+
+/* Prints the value of an expression given with -e. Returns false if it
+ * does not compile. */
+static bool print_value(GApplicationCommandLine *cmdline, const char *text)
+{
+    Program prog;
+    ExprError error;
+    char result[FMT_LEN];
+
+    if (!expr_compile_const(&prog, text, strlen(text), &error)) {
+        g_application_command_line_printerr(cmdline,
+                                            "calc: %s: %s at column %zu\n",
+                                            text, error.msg, error.pos + 1);
+        return false;
+    }
+
+    format_num(result, sizeof(result), vm_eval(&prog, 0), FMT_MAX_DIGITS);
+    g_application_command_line_print(cmdline, "%s\n", result);
+    return true;
+}
+
+/* An import asked for on a command line, which waits for its outcome */
+typedef struct Pending {
+    Data *data;
+    GApplication *app;
+    GApplicationCommandLine *cmdline;
+    char *path;
+} Pending;
+
+/* Called on the main thread once an import has finished, failed or been
+ * cancelled. The total becomes the number shown, and the outcome is
+ * printed on the command line that asked for it. */
+static void import_done(GObject *source, GAsyncResult *res,
+                        gpointer user_data)
+{
+    (void)source;
+
+    Pending *pending = (Pending *)user_data;
+    Data *data = pending->data;
+    GApplicationCommandLine *cmdline = pending->cmdline;
+    ImportResult result;
+    GError *error = NULL;
+
+    if (import_file_finish(res, &result, &error)) {
+        char total[FMT_LEN];
+        format_num(total, sizeof(total), result.total, FMT_MAX_DIGITS);
+        engine_set_value(data->engine, result.total);
+        g_application_command_line_print(cmdline, "%zu lines, total %s\n",
+                                         result.lines, total);
+        if (result.failed > 0) {
+            g_application_command_line_printerr(cmdline,
+                "calc: %s: %zu lines did not compile, the first is line "
+                "%zu\n", pending->path, result.failed, result.first_failed);
+            g_application_command_line_set_exit_status(cmdline,
+                                                       EXIT_FAILURE);
+        }
+    } else {
+        g_application_command_line_printerr(cmdline, "calc: %s: %s\n",
+                                            pending->path, error->message);
+        g_application_command_line_set_exit_status(cmdline, EXIT_FAILURE);
+        g_error_free(error);
+    }
+
+    g_clear_object(&data->import);
+    if (data->progress_tick != 0) {
+        gtk_widget_remove_tick_callback(data->f, data->progress_tick);
+        data->progress_tick = 0;
+    }
+    queue_display(data);
+
+    /* the calling calc exits once its command line is released */
+    g_application_release(pending->app);
+    g_object_unref(cmdline);
+    g_free(pending->path);
+    g_free(pending);
+}
+
+/* Shows the calculator and starts importing the file named by arg, which
+ * is relative to the directory calc was started in, on a worker thread.
+ * Returns an exit status; if the import starts, the outcome is printed
+ * and the status set once it is done. */
+static int start_import(GApplication *app, GApplicationCommandLine *cmdline,
+                        const char *arg, Data *data)
+{
+    if (data->import != NULL) {
+        g_application_command_line_printerr(cmdline,
+                                    "calc: an import is already running\n");
+        return EXIT_FAILURE;
+    }
+
+    g_application_activate(app);
+
+    GFile *file = g_application_command_line_create_file_for_arg(cmdline,
+                                                                 arg);
+    Pending *pending = g_new(Pending, 1);
+    pending->data = data;
+    pending->app = app;
+    pending->cmdline = g_object_ref(cmdline);
+    pending->path = g_file_get_path(file);
+    g_object_unref(file);
+
+    /* the application stays up, even if the window is closed, until the
+     * worker thread is done */
+    g_application_hold(app);
+    data->import = g_cancellable_new();
+
+    if (data->tick != 0) {
+        gtk_widget_remove_tick_callback(data->f, data->tick);
+        data->tick = 0;
+    }
+    data->progress_tick = gtk_widget_add_tick_callback(data->f,
+                                                       show_progress,
+                                                       data, NULL);
+    import_file_async(pending->path, &data->progress, data->import,
+                      import_done, pending);
+    return EXIT_SUCCESS;
+}
+
+/* Callback for the "command-line" signal. Runs in the first calculator
+ * started, even when the command line was given to a later one, which
+ * just waits for the exit status: "calc -e EXPRESSION..." prints the
+ * value of each expression, "calc" shows the calculator,
+ * "calc --scientific" shows it in scientific mode, and "calc --import
+ * FILE" shows it while adding up the expressions in FILE. */
+static int command_line(GApplication *app, GApplicationCommandLine *cmdline,
+                        gpointer user_data)
+{
+    int argc;
+    char **argv = g_application_command_line_get_arguments(cmdline, &argc);
+    int status = EXIT_SUCCESS;
+
+    if (argc >= 3 && (strcmp(argv[1], "-e") == 0 ||
+                      strcmp(argv[1], "--eval") == 0)) {
+        for (int i = 2; i < argc; i++) {
+            if (!print_value(cmdline, argv[i])) status = EXIT_FAILURE;
+        }
+    }
+    else if (argc == 2 && strcmp(argv[1], "--scientific") == 0) {
+        g_application_activate(app);
+        GtkWindow *window =
+            gtk_application_get_active_window(GTK_APPLICATION(app));
+        g_action_group_change_action_state(G_ACTION_GROUP(window),
+                                 "scientific", g_variant_new_boolean(TRUE));
+    }
+    else if (argc == 3 && strcmp(argv[1], "--import") == 0) {
+        status = start_import(app, cmdline, argv[2], (Data *)user_data);
+    }
+    else if (argc >= 2) {
+        g_application_command_line_printerr(cmdline,
+            "usage: calc [--scientific | -e EXPRESSION... | --import FILE]"
+            " | calc --batch [FILE]\n");
+        status = EXIT_FAILURE;
+    }
+    else {
+        g_application_activate(app);
+    }
+
+    g_strfreev(argv);
+    return status;
 }
 
 int main(int argc, char *argv[])
 {
+    startup_init();
+
+    /* "calc --batch [FILE]" evaluates expressions without opening a window */
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+        return batch_run_file(argc >= 3 ? argv[2] : NULL);
+    }
+
     /* create instance of a Data object */
     Data *data = (Data *)malloc(sizeof(struct Data));
-    data->op = DEFAULT;
-    data->num = 0;
-    data->result = 0;
+    data->engine = engine_new();
     data->f = NULL;
-
-    /* create new application instance */
+    data->sci = NULL;
+    data->history = NULL;
+    data->tape = NULL;
+    data->tick = 0;
+    data->import = NULL;
+    data->progress = 0;
+    data->progress_tick = 0;
+    data->changes = data->updates = data->frames = 0;
+
+    /* create new application instance. Only the first one started does
+     * any work: later ones pass their command line to it and exit, unless
+     * startup is traced, which times a launch of its own. */
+    GApplicationFlags flags = G_APPLICATION_HANDLES_COMMAND_LINE;
+    if (startup_tracing()) flags |= G_APPLICATION_NON_UNIQUE;
     GtkApplication *app = gtk_application_new("com.example.GtkApplication",
-                                              G_APPLICATION_DEFAULT_FLAGS);
+                                              flags);
 
-    /* connect "activate" signal to the activate callback */
+    /* connect "startup", "activate" and "command-line" signals to their
+     * callbacks */
+    g_signal_connect(app, "startup", G_CALLBACK(open_history), data);
     g_signal_connect(app, "activate", G_CALLBACK(activate), data);
+    g_signal_connect(app, "command-line", G_CALLBACK(command_line), data);
 
     /* run the application */
+    startup_mark("g_application_run");
     int status = g_application_run(G_APPLICATION(app), argc, argv);
 
+    if (g_getenv("CALC_DISPLAY_STATS") != NULL) {
+        g_printerr("display: %lu changes, %lu label updates, %lu frames\n",
+                   data->changes, data->updates, data->frames);
+    }
+
     /* clean up application resources */
     g_clear_object(&app);
+    engine_free(data->engine);
+    g_clear_object(&data->tape);
+    history_close(data->history);
     free(data);
 
     return status;
@@ -0,0 +1,233 @@
+/*********************** column.c ***********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of column mode.
+ * Values are evaluated in blocks: each instruction runs a
+ * kernel over a whole block of the evaluation stack, so
+ * dispatch is paid once per block instead of once per
+ * value. Arithmetic, square root, square and cube have
+ * SSE2 and AVX2 kernels; the remaining operations call
+ * libm for each value, as the VM does, so that results are
+ * identical whichever instruction set is used.
+ *
+ *******************************************************/
+
+#include "column.h"
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86 1
+#include <immintrin.h>
+#else
+#define HAVE_X86 0
+#endif
+
+/* Kernel computing a = a op b over n values */
+typedef void (*binary_kernel)(double *a, const double *b, size_t n);
+
+/* Kernel computing a = op(a) over n values */
+typedef void (*unary_kernel)(double *a, size_t n);
+
+/* Kernels for every operation, indexed by operator and special */
+typedef struct Kernels {
+    binary_kernel binary[DEFAULT];
+    unary_kernel unary[NUL];
+} Kernels;
+
+/* Scalar kernels */
+
+#define SCALAR_BINARY(name, expr) \
+    static void name(double *a, const double *b, size_t n) \
+    { \
+        for (size_t i = 0; i < n; i++) a[i] = (expr); \
+    }
+
+#define SCALAR_UNARY(name, expr) \
+    static void name(double *a, size_t n) \
+    { \
+        for (size_t i = 0; i < n; i++) a[i] = (expr); \
+    }
+
+SCALAR_BINARY(div_scalar, a[i] / b[i])
+SCALAR_BINARY(mul_scalar, a[i] * b[i])
+SCALAR_BINARY(add_scalar, a[i] + b[i])
+SCALAR_BINARY(sub_scalar, a[i] - b[i])
+
+SCALAR_UNARY(fac_scalar, factorial(a[i]))
+SCALAR_UNARY(sqt_scalar, sqrt(a[i]))
+SCALAR_UNARY(cbt_scalar, cbrt(a[i]))
+SCALAR_UNARY(sgn_scalar, 0 - a[i])
+SCALAR_UNARY(pct_scalar, a[i] / (float)100)
+SCALAR_UNARY(sqr_scalar, a[i] * a[i])
+SCALAR_UNARY(cub_scalar, a[i] * a[i] * a[i])
+SCALAR_UNARY(sin_scalar, sin(a[i]))
+SCALAR_UNARY(cos_scalar, cos(a[i]))
+SCALAR_UNARY(tan_scalar, tan(a[i]))
+
+static const Kernels scalar_kernels = {
+    { div_scalar, mul_scalar, add_scalar, sub_scalar },
+    { fac_scalar, sqt_scalar, cbt_scalar, sgn_scalar, pct_scalar,
+      sqr_scalar, cub_scalar, sin_scalar, cos_scalar, tan_scalar }
+};
+
+#if HAVE_X86
+
+/* Vector kernels. Each processes width values per step, then finishes the
+ * remainder with the scalar expression. vexpr sees the vector as v (and w
+ * for the second operand); sexpr sees the scalar as a[i] (and b[i]). */
+
+#define VECTOR_BINARY(name, features, vec, width, load, store, \
+                      vexpr, sexpr) \
+    __attribute__((target(features))) \
+    static void name(double *a, const double *b, size_t n) \
+    { \
+        size_t i = 0; \
+        for (; i + (width) <= n; i += (width)) { \
+            vec v = load(a + i), w = load(b + i); \
+            store(a + i, (vexpr)); \
+        } \
+        for (; i < n; i++) a[i] = (sexpr); \
+    }
+
+#define VECTOR_UNARY(name, features, vec, width, load, store, \
+                     vexpr, sexpr) \
+    __attribute__((target(features))) \
+    static void name(double *a, size_t n) \
+    { \
+        size_t i = 0; \
+        for (; i + (width) <= n; i += (width)) { \
+            vec v = load(a + i); \
+            store(a + i, (vexpr)); \
+        } \
+        for (; i < n; i++) a[i] = (sexpr); \
+    }
+
+#define SSE2_BINARY(name, vexpr, sexpr) \
+    VECTOR_BINARY(name, "sse2", __m128d, 2, _mm_loadu_pd, _mm_storeu_pd, \
+                  vexpr, sexpr)
+#define SSE2_UNARY(name, vexpr, sexpr) \
+    VECTOR_UNARY(name, "sse2", __m128d, 2, _mm_loadu_pd, _mm_storeu_pd, \
+                 vexpr, sexpr)
+
+SSE2_BINARY(div_sse2, _mm_div_pd(v, w), a[i] / b[i])
+SSE2_BINARY(mul_sse2, _mm_mul_pd(v, w), a[i] * b[i])
+SSE2_BINARY(add_sse2, _mm_add_pd(v, w), a[i] + b[i])
+SSE2_BINARY(sub_sse2, _mm_sub_pd(v, w), a[i] - b[i])
+
+SSE2_UNARY(sqt_sse2, _mm_sqrt_pd(v), sqrt(a[i]))
+SSE2_UNARY(sgn_sse2, _mm_sub_pd(_mm_setzero_pd(), v), 0 - a[i])
+SSE2_UNARY(pct_sse2, _mm_div_pd(v, _mm_set1_pd(100)), a[i] / (float)100)
+SSE2_UNARY(sqr_sse2, _mm_mul_pd(v, v), a[i] * a[i])
+SSE2_UNARY(cub_sse2, _mm_mul_pd(_mm_mul_pd(v, v), v), a[i] * a[i] * a[i])
+
+static const Kernels sse2_kernels = {
+    { div_sse2, mul_sse2, add_sse2, sub_sse2 },
+    { fac_scalar, sqt_sse2, cbt_scalar, sgn_sse2, pct_sse2,
+      sqr_sse2, cub_sse2, sin_scalar, cos_scalar, tan_scalar }
+};
+
+#define AVX2_BINARY(name, vexpr, sexpr) \
+    VECTOR_BINARY(name, "avx2", __m256d, 4, _mm256_loadu_pd, \
+                  _mm256_storeu_pd, vexpr, sexpr)
+#define AVX2_UNARY(name, vexpr, sexpr) \
+    VECTOR_UNARY(name, "avx2", __m256d, 4, _mm256_loadu_pd, \
+                 _mm256_storeu_pd, vexpr, sexpr)
+
+AVX2_BINARY(div_avx2, _mm256_div_pd(v, w), a[i] / b[i])
+AVX2_BINARY(mul_avx2, _mm256_mul_pd(v, w), a[i] * b[i])
+AVX2_BINARY(add_avx2, _mm256_add_pd(v, w), a[i] + b[i])
+AVX2_BINARY(sub_avx2, _mm256_sub_pd(v, w), a[i] - b[i])
+
+AVX2_UNARY(sqt_avx2, _mm256_sqrt_pd(v), sqrt(a[i]))
+AVX2_UNARY(sgn_avx2, _mm256_sub_pd(_mm256_setzero_pd(), v), 0 - a[i])
+AVX2_UNARY(pct_avx2, _mm256_div_pd(v, _mm256_set1_pd(100)),
+           a[i] / (float)100)
+AVX2_UNARY(sqr_avx2, _mm256_mul_pd(v, v), a[i] * a[i])
+AVX2_UNARY(cub_avx2, _mm256_mul_pd(_mm256_mul_pd(v, v), v),
+           a[i] * a[i] * a[i])
+
+static const Kernels avx2_kernels = {
+    { div_avx2, mul_avx2, add_avx2, sub_avx2 },
+    { fac_scalar, sqt_avx2, cbt_scalar, sgn_avx2, pct_avx2,
+      sqr_avx2, cub_avx2, sin_scalar, cos_scalar, tan_scalar }
+};
+
+#endif
+
+/* Returns the kernels for the given instruction set, or NULL if the
+ * machine does not support it */
+static const Kernels *kernels_for(isa set)
+{
+    if (set == ISA_AUTO) set = column_isa();
+
+    switch (set) {
+        case ISA_SCALAR: return &scalar_kernels;
+#if HAVE_X86
+        case ISA_SSE2:
+            return __builtin_cpu_supports("sse2") ? &sse2_kernels : NULL;
+        case ISA_AVX2:
+            return __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL;
+#endif
+        default: return NULL;
+    }
+}
+
+isa column_isa(void)
+{
+#if HAVE_X86
+    if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+    if (__builtin_cpu_supports("sse2")) return ISA_SSE2;
+#endif
+    return ISA_SCALAR;
+}
+
+/* Evaluates prog over one block of m <= COLUMN_BLOCK values */
+static void eval_block(const Program *prog, const Kernels *kernels,
+                       const double *x, double *out, size_t m)
+{
+    _Alignas(32) double stack[EXPR_MAX_DEPTH][COLUMN_BLOCK];
+    const double *constant = prog->consts;
+    int top = -1;
+
+    for (const unsigned char *pc = prog->code; ; pc++) {
+        opcode op = (opcode)*pc;
+
+        if (op == OP_NUM) {
+            double num = *constant++;
+            top++;
+            for (size_t i = 0; i < m; i++) stack[top][i] = num;
+        }
+        else if (op == OP_VAR) {
+            memcpy(stack[++top], x, m * sizeof(double));
+        }
+        else if (op <= OP_SUB) {
+            top--;
+            kernels->binary[op - OP_DIV](stack[top], stack[top + 1], m);
+        }
+        else if (op <= OP_TAN) {
+            kernels->unary[op - OP_FAC](stack[top], m);
+        }
+        else {
+            memcpy(out, stack[0], m * sizeof(double));
+            return;
+        }
+    }
+}
+
+bool column_eval_isa(const Program *prog, const double *x, double *out,
+                     size_t n, isa set)
+{
+    const Kernels *kernels = kernels_for(set);
+    if (kernels == NULL) return false;
+
+    for (size_t i = 0; i < n; i += COLUMN_BLOCK) {
+        size_t m = (n - i < COLUMN_BLOCK) ? n - i : COLUMN_BLOCK;
+        eval_block(prog, kernels, x + i, out + i, m);
+    }
+    return true;
+}
+
+void column_eval(const Program *prog, const double *x, double *out, size_t n)
+{
+    column_eval_isa(prog, x, out, n, ISA_AUTO);
+}
@@ -0,0 +1,39 @@
+/*********************** column.h ***********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to column mode, which evaluates one compiled
+ * expression over whole arrays of values of the variable x
+ * using SIMD instructions where the machine has them.
+ *
+ *******************************************************/
+
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include <stddef.h>
+#include "expr.h"
+
+/* Number of values evaluated together, one instruction at a time */
+#define COLUMN_BLOCK 256
+
+/* Enum representing the instruction sets column mode can use */
+typedef enum {
+    ISA_AUTO,   /* best instruction set the machine supports */
+    ISA_SCALAR, /* plain C, one value at a time */
+    ISA_SSE2,   /* two values per instruction */
+    ISA_AVX2    /* four values per instruction */
+} isa;
+
+/* Sets out[i] to the value of prog with the variable x set to x[i], for
+ * every i < n. Results are identical to calling vm_eval once per value. */
+void column_eval(const Program *prog, const double *x, double *out, size_t n);
+
+/* Same as column_eval, but uses the given instruction set. Returns false,
+ * and does nothing, if the machine does not support it. */
+bool column_eval_isa(const Program *prog, const double *x, double *out,
+                     size_t n, isa set);
+
+/* Returns the instruction set column_eval uses on this machine */
+isa column_isa(void);
+
+#endif
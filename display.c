@@ -0,0 +1,219 @@
+/*********************** display.c **********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the display
+ * widget. The text is shaped once, when it changes, into
+ * a PangoLayout kept for the widget's lifetime; drawing
+ * only scales and places that layout in the snapshot.
+ *
+ *******************************************************/
+
+#include "display.h"
+#include <string.h>
+
+/* Size of the text, relative to the widget's font */
+#define TEXT_SCALE PANGO_SCALE_X_LARGE
+
+/* Smallest fraction of its size text is shrunk to before it scrolls */
+#define MIN_SCALE 0.5
+
+/* Space left around the text, in pixels */
+#define PADDING 6
+
+/* Pixels scrolled per step of a mouse wheel */
+#define SCROLL_STEP 24
+
+struct _CalcDisplay {
+    GtkWidget parent_instance;
+    GString *text;       /* Text shown */
+    PangoLayout *layout; /* Text, shaped when it last changed */
+    int text_width;      /* Width of the text at full size, in pixels */
+    int text_height;     /* Height of the text at full size, in pixels */
+    double overflow;     /* Pixels of text that did not fit when drawn */
+    double scroll;       /* Pixels the text is scrolled right by, to show
+                          * its start; 0 shows its end */
+};
+
+G_DEFINE_TYPE(CalcDisplay, calc_display, GTK_TYPE_WIDGET)
+
+/* Shapes the text, which is the only time Pango does any work */
+static void shape(CalcDisplay *display)
+{
+    pango_layout_set_text(display->layout, display->text->str,
+                          (int)display->text->len);
+    pango_layout_get_pixel_size(display->layout, &display->text_width,
+                                &display->text_height);
+}
+
+/* Shapes the text again after its font may have changed. The widget is
+ * only laid out again if the text's height changed with it. */
+static void reshape(CalcDisplay *display)
+{
+    int height = display->text_height;
+
+    pango_layout_context_changed(display->layout);
+    shape(display);
+    if (display->text_height != height) {
+        gtk_widget_queue_resize(GTK_WIDGET(display));
+    } else {
+        gtk_widget_queue_draw(GTK_WIDGET(display));
+    }
+}
+
+/* Sizes do not depend on the text, so that new text never causes the
+ * window to be laid out again; the grid decides the width */
+static void calc_display_measure(GtkWidget *widget,
+                                 GtkOrientation orientation, int for_size,
+                                 int *minimum, int *natural,
+                                 int *minimum_baseline,
+                                 int *natural_baseline)
+{
+    (void)for_size;
+    (void)minimum_baseline;
+    (void)natural_baseline;
+
+    CalcDisplay *display = CALC_DISPLAY(widget);
+
+    if (orientation == GTK_ORIENTATION_HORIZONTAL) {
+        *minimum = *natural = 2 * PADDING;
+    } else {
+        *minimum = *natural = display->text_height + 2 * PADDING;
+    }
+}
+
+static void calc_display_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    CalcDisplay *display = CALC_DISPLAY(widget);
+    int width = gtk_widget_get_width(widget);
+    int height = gtk_widget_get_height(widget);
+    int room = width - 2 * PADDING;
+    GdkRGBA color;
+
+    /* shrink text that does not fit, then scroll what still does not */
+    double scale = 1;
+    if (display->text_width > room && room > 0) {
+        scale = MAX((double)room / display->text_width, MIN_SCALE);
+    }
+    display->overflow = MAX(display->text_width * scale - room, 0);
+    display->scroll = CLAMP(display->scroll, 0, display->overflow);
+
+#if GTK_CHECK_VERSION(4, 10, 0)
+    gtk_widget_get_color(widget, &color);
+#else
+    gtk_style_context_get_color(gtk_widget_get_style_context(widget),
+                                &color);
+#endif
+
+    gtk_snapshot_push_clip(snapshot, &GRAPHENE_RECT_INIT(0, 0, width, height));
+    gtk_snapshot_save(snapshot);
+    gtk_snapshot_translate(snapshot, &GRAPHENE_POINT_INIT(
+        width - PADDING - display->text_width * scale + display->scroll,
+        (height - display->text_height * scale) / 2));
+    gtk_snapshot_scale(snapshot, scale, scale);
+    gtk_snapshot_append_layout(snapshot, display->layout, &color);
+    gtk_snapshot_restore(snapshot);
+    gtk_snapshot_pop(snapshot);
+}
+
+/* Reshapes the text when the font it is drawn in changes */
+static void calc_display_system_setting_changed(GtkWidget *widget,
+                                                GtkSystemSetting setting)
+{
+    GTK_WIDGET_CLASS(calc_display_parent_class)
+        ->system_setting_changed(widget, setting);
+
+    if (setting == GTK_SYSTEM_SETTING_FONT_NAME ||
+        setting == GTK_SYSTEM_SETTING_FONT_CONFIG ||
+        setting == GTK_SYSTEM_SETTING_DPI) {
+        reshape(CALC_DISPLAY(widget));
+    }
+}
+
+/* Reshapes the text when CSS may have changed its font. The parent class
+ * updates the widget's Pango context first. */
+static void calc_display_css_changed(GtkWidget *widget,
+                                     GtkCssStyleChange *change)
+{
+    GTK_WIDGET_CLASS(calc_display_parent_class)->css_changed(widget, change);
+    reshape(CALC_DISPLAY(widget));
+}
+
+/* Scrolls text that does not fit; up and left show its start */
+static gboolean on_scroll(GtkEventControllerScroll *controller, double dx,
+                          double dy, gpointer user_data)
+{
+    (void)controller;
+
+    CalcDisplay *display = CALC_DISPLAY(user_data);
+
+    if (display->overflow <= 0) return FALSE;
+
+    display->scroll -= (dx + dy) * SCROLL_STEP;
+    gtk_widget_queue_draw(GTK_WIDGET(display));
+    return TRUE;
+}
+
+static void calc_display_dispose(GObject *object)
+{
+    g_clear_object(&CALC_DISPLAY(object)->layout);
+    G_OBJECT_CLASS(calc_display_parent_class)->dispose(object);
+}
+
+static void calc_display_finalize(GObject *object)
+{
+    g_string_free(CALC_DISPLAY(object)->text, TRUE);
+    G_OBJECT_CLASS(calc_display_parent_class)->finalize(object);
+}
+
+static void calc_display_class_init(CalcDisplayClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+    object_class->dispose = calc_display_dispose;
+    object_class->finalize = calc_display_finalize;
+    widget_class->measure = calc_display_measure;
+    widget_class->snapshot = calc_display_snapshot;
+    widget_class->system_setting_changed =
+        calc_display_system_setting_changed;
+    widget_class->css_changed = calc_display_css_changed;
+    gtk_widget_class_set_css_name(widget_class, "calcdisplay");
+}
+
+static void calc_display_init(CalcDisplay *display)
+{
+    PangoAttrList *attrs = pango_attr_list_new();
+    pango_attr_list_insert(attrs, pango_attr_scale_new(TEXT_SCALE));
+
+    display->text = g_string_new("0");
+    display->layout = gtk_widget_create_pango_layout(GTK_WIDGET(display),
+                                                     NULL);
+    pango_layout_set_attributes(display->layout, attrs);
+    pango_attr_list_unref(attrs);
+    shape(display);
+
+    GtkEventController *scroll = gtk_event_controller_scroll_new(
+        GTK_EVENT_CONTROLLER_SCROLL_BOTH_AXES);
+    g_signal_connect(scroll, "scroll", G_CALLBACK(on_scroll), display);
+    gtk_widget_add_controller(GTK_WIDGET(display), scroll);
+}
+
+GtkWidget *calc_display_new(void)
+{
+    return g_object_new(CALC_TYPE_DISPLAY, NULL);
+}
+
+void calc_display_set_text(CalcDisplay *display, const char *text)
+{
+    if (strcmp(display->text->str, text) == 0) return;
+
+    g_string_assign(display->text, text);
+    shape(display);
+    display->scroll = 0;
+    gtk_widget_queue_draw(GTK_WIDGET(display));
+}
+
+const char *calc_display_get_text(CalcDisplay *display)
+{
+    return display->text->str;
+}
@@ -0,0 +1,30 @@
+/*********************** display.h **********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the calculator's display. CalcDisplay draws
+ * one line of text with a PangoLayout it keeps between
+ * updates. Its size does not depend on the text, so a new
+ * value only needs the widget redrawn, never the window
+ * laid out again. Text too wide for the widget is shrunk,
+ * down to half size, and beyond that can be scrolled.
+ *
+ *******************************************************/
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <gtk/gtk.h>
+
+#define CALC_TYPE_DISPLAY (calc_display_get_type())
+G_DECLARE_FINAL_TYPE(CalcDisplay, calc_display, CALC, DISPLAY, GtkWidget)
+
+/* Creates a display showing "0" */
+GtkWidget *calc_display_new(void);
+
+/* Shows text, right aligned. Does nothing if text is already shown. */
+void calc_display_set_text(CalcDisplay *display, const char *text);
+
+/* Returns the text shown, which is owned by the display */
+const char *calc_display_get_text(CalcDisplay *display);
+
+#endif
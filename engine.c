@@ -0,0 +1,484 @@
+/*********************** engine.c ***********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the calculator
+ * engine. It has no dependency on GTK; the GUI in calc.c
+ * is a thin client of the functions defined here.
+ *
+ *******************************************************/
+
+#include "engine.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include "format.h"
+
+/* Most significant digits shown on the display */
+#define TOT_DIGITS 12
+
+/* Most digits that can be typed into one number */
+#define ENTRY_DIGITS 32
+
+/* Longest display text: a formatted number, or a typed number with its
+ * sign and decimal point */
+#define DISPLAY_LEN FMT_LEN
+_Static_assert(ENTRY_DIGITS + 3 <= DISPLAY_LEN, "display too short");
+
+/* Enum representing the states of the keypad. Besides what the display
+ * shows, the state records whatever else decides how the next key is
+ * handled, so that each key is handled by a single table lookup. */
+typedef enum {
+    ST_NUM,        /* a number other than 0, inf or nan */
+    ST_ZERO,       /* the number 0; a "0" key is ignored */
+    ST_ERROR,      /* inf or nan; the next number starts over */
+    ST_OP,         /* the pending binary operator */
+    ST_ENTRY,      /* the number being typed, exactly as typed */
+    ST_ENTRY_ZERO, /* "0" being typed; the next digit replaces it */
+    ST_COUNT
+} state;
+
+/* A number being typed, kept as its digits so that it can be converted
+ * exactly, and only once, when it is used. For example, "-2.50" is stored
+ * as negative, digits "250" and point 1. */
+typedef struct Entry {
+    bool negative;
+    int len;                   /* Number of digits typed */
+    int point;                 /* Digits before the decimal point, or -1
+                                * if no decimal point has been typed */
+    char digits[ENTRY_DIGITS]; /* Digits typed, without the point */
+} Entry;
+
+/* Object storing information about the calculator's current state */
+struct Engine {
+    /* Number being typed. Is only meaningful in the entry states, and
+     * replaces num until an operation needs its value. */
+    Entry entry;
+
+    /* Current operation being performed. For example, if the user inputs
+     * "2 + 2 =", then op = DEFAULT until "+" is pressed, at which point
+     * op = ADD until "=" is entered. */
+    operator op;
+
+    double num;    /* Stores the current number */
+    double result; /* Result of operations since the last "Clear" or "=" */
+
+    /* The display text is only formatted when it is asked for, so batch
+     * callers never pay for formatting. */
+    state state;            /* State of the keypad */
+    bool stale;             /* Is true if text needs to be regenerated */
+    char text[DISPLAY_LEN]; /* Formatted display text */
+
+    engine_hook hook; /* Called after each binary operation, if not NULL */
+    void *hook_data;
+};
+
+/* Moves to a new state, which the display shows */
+static void show(Engine *engine, state st)
+{
+    engine->state = st;
+    engine->stale = true;
+}
+
+/* Shows the current number, in the state its value calls for */
+static void show_num(Engine *engine)
+{
+    if (engine->num == 0) {
+        show(engine, ST_ZERO);
+    } else if (engine->num == INFINITY || isnan(engine->num)) {
+        show(engine, ST_ERROR);
+    } else {
+        show(engine, ST_NUM);
+    }
+}
+
+/* Shows the number being typed, in the state its digits call for */
+static void show_entry(Engine *engine)
+{
+    const Entry *entry = &engine->entry;
+    bool zero = entry->len == 1 && entry->digits[0] == '0' &&
+                entry->point < 0 && !entry->negative;
+    show(engine, zero ? ST_ENTRY_ZERO : ST_ENTRY);
+}
+
+/* Is true if the state is one of the entry states */
+static bool is_entry(state st)
+{
+    return st == ST_ENTRY || st == ST_ENTRY_ZERO;
+}
+
+/* Starts typing a new number, made of the single digit d */
+static void start_entry(Engine *engine, char d)
+{
+    engine->entry.negative = false;
+    engine->entry.len = 1;
+    engine->entry.point = -1;
+    engine->entry.digits[0] = d;
+    show_entry(engine);
+}
+
+/* Starts typing a new number from the one on the display, so that typing
+ * carries on from what the user sees. Numbers shown with an exponent, or
+ * too long to type, start over from 0 instead. */
+static void continue_entry(Engine *engine)
+{
+    char text[FMT_LEN];
+    const char *c = text;
+    Entry *entry = &engine->entry;
+
+    format_num(text, sizeof(text), engine->num, TOT_DIGITS);
+    start_entry(engine, '0');
+    entry->len = 0;
+
+    if (*c == '-') {
+        entry->negative = true;
+        c++;
+    }
+    for (; *c != '\0'; c++) {
+        if (*c == '.') {
+            entry->point = entry->len;
+        } else if (*c >= '0' && *c <= '9' && entry->len < ENTRY_DIGITS) {
+            entry->digits[entry->len++] = *c;
+        } else {
+            start_entry(engine, '0');
+            return;
+        }
+    }
+    show_entry(engine);
+}
+
+/* Returns the value of the number being typed */
+static double entry_value(const Entry *entry)
+{
+    int decimals = (entry->point < 0) ? 0 : entry->len - entry->point;
+    double value = format_parse(entry->digits, entry->len, -decimals);
+    return entry->negative ? -value : value;
+}
+
+/* If a number is being typed, converts it and makes it the current
+ * number. Called before anything uses the current number. */
+static void end_entry(Engine *engine)
+{
+    if (is_entry(engine->state)) {
+        engine->num = entry_value(&engine->entry);
+        show_num(engine);
+    }
+}
+
+/* Writes the number being typed, exactly as typed, into buf */
+static void entry_text(const Entry *entry, char *buf)
+{
+    if (entry->negative) *buf++ = '-';
+    for (int i = 0; i < entry->len; i++) {
+        if (i == entry->point) *buf++ = '.';
+        *buf++ = entry->digits[i];
+    }
+    if (entry->point == entry->len) *buf++ = '.';
+    *buf = '\0';
+}
+
+Engine *engine_new(void)
+{
+    Engine *engine = malloc(sizeof(struct Engine));
+    if (engine != NULL) {
+        engine->hook = NULL;
+        engine->hook_data = NULL;
+        engine->state = ST_ZERO;
+        engine_clear(engine);
+    }
+    return engine;
+}
+
+void engine_free(Engine *engine)
+{
+    free(engine);
+}
+
+/* Actions taken on a key. Each is only called in the states the
+ * transition table below gives it for. */
+typedef void (*action)(Engine *engine, key k);
+
+/* Ignores the key */
+static void ignore(Engine *engine, key k)
+{
+    (void)engine;
+    (void)k;
+}
+
+/* Starts a new number with the digit, after an operator */
+static void digit_start(Engine *engine, key k)
+{
+    start_entry(engine, (char)('0' + (k - KEY_0)));
+}
+
+/* Starts over from the digit, after inf or nan */
+static void digit_restart(Engine *engine, key k)
+{
+    engine->num = 0;
+    engine->result = 0;
+    start_entry(engine, (char)('0' + (k - KEY_0)));
+}
+
+/* Appends the digit to the number shown, replacing a lone "0" */
+static void digit_append(Engine *engine, key k)
+{
+    if (!is_entry(engine->state)) continue_entry(engine);
+
+    Entry *entry = &engine->entry;
+    if (engine->state == ST_ENTRY_ZERO) {
+        entry->digits[0] = (char)('0' + (k - KEY_0));
+    } else if (entry->len < ENTRY_DIGITS) {
+        entry->digits[entry->len++] = (char)('0' + (k - KEY_0));
+    }
+    show_entry(engine);
+}
+
+/* Adds a decimal point to the number being typed; repeated decimal points
+ * are ignored */
+static void point_add(Engine *engine, key k)
+{
+    (void)k;
+
+    Entry *entry = &engine->entry;
+    if (entry->point < 0) entry->point = entry->len;
+    show(engine, ST_ENTRY);
+}
+
+/* Adds a decimal point to the number shown */
+static void point_append(Engine *engine, key k)
+{
+    continue_entry(engine);
+    point_add(engine, k);
+}
+
+/* Starts over from "0.", after inf or nan */
+static void point_restart(Engine *engine, key k)
+{
+    engine->num = 0;
+    engine->result = 0;
+    start_entry(engine, '0');
+    point_add(engine, k);
+}
+
+/* Applies a unary operator to the number shown */
+static void special_apply(Engine *engine, key k)
+{
+    special op = (special)(k - KEY_FAC);
+
+    end_entry(engine);
+    engine->num = un_op(engine->num, op);
+    show_num(engine);
+}
+
+/* Evaluates the stored expression, then either stores the operator or,
+ * for "=", shows the result. Division by zero results in "inf" */
+static void binary_apply(Engine *engine, key k)
+{
+    operator op = (operator)(k - KEY_DIV);
+
+    end_entry(engine);
+
+    /* evaluate stored expression */
+    double left = engine->result;
+    engine->result = bin_op(left, engine->op, engine->num);
+    if (engine->op != DEFAULT && engine->hook != NULL) {
+        engine->hook(engine->hook_data, left, engine->op, engine->num,
+                     engine->result);
+    }
+    engine->op = op;
+
+    /* if "=" was entered, display result */
+    if (op == DEFAULT) {
+        engine->num = engine->result;
+        show_num(engine);
+        engine->result = 0;
+        return;
+    }
+
+    show(engine, ST_OP);
+}
+
+/* Erases the last character of the number being typed: the decimal point
+ * if it was typed last, or else the last digit. Erasing the only digit
+ * leaves "0". */
+static void back_erase(Engine *engine, key k)
+{
+    (void)k;
+
+    Entry *entry = &engine->entry;
+
+    if (entry->point == entry->len) {
+        entry->point = -1;
+    } else if (entry->len > 1) {
+        entry->len--;
+    } else {
+        start_entry(engine, '0');
+        return;
+    }
+    show_entry(engine);
+}
+
+/* Clears and resets the calculator */
+static void clear_all(Engine *engine, key k)
+{
+    (void)k;
+
+    engine->op = DEFAULT;
+    engine->result = 0;
+    engine->num = 0;
+
+    show(engine, ST_ZERO);
+}
+
+/* Enum representing the classes of key the transition table tells apart */
+typedef enum {
+    EV_ZERO, EV_DIGIT, EV_POINT, EV_BINARY, EV_SPECIAL, EV_CLEAR, EV_BACK,
+    EV_NONE, EV_COUNT
+} event;
+
+/* Class of each key */
+static const event events[KEY_NONE + 1] = {
+    EV_ZERO,
+    EV_DIGIT, EV_DIGIT, EV_DIGIT, EV_DIGIT, EV_DIGIT,
+    EV_DIGIT, EV_DIGIT, EV_DIGIT, EV_DIGIT,
+    EV_POINT,
+    EV_BINARY, EV_BINARY, EV_BINARY, EV_BINARY, EV_BINARY,
+    EV_SPECIAL, EV_SPECIAL, EV_SPECIAL, EV_SPECIAL, EV_SPECIAL,
+    EV_SPECIAL, EV_SPECIAL, EV_SPECIAL, EV_SPECIAL, EV_SPECIAL,
+    EV_CLEAR, EV_BACK, EV_NONE
+};
+
+/* Action taken on each class of key in each state. Operators, special
+ * keys and points are ignored while an operator is shown; a "0" is
+ * ignored while 0 is shown; after inf or nan, numbers start over; only
+ * numbers being typed can be erased. */
+static const action transitions[ST_COUNT][EV_COUNT] = {
+    /*                  0              1-9            .
+     *                  binary         special        C
+     *                  back           none */
+    [ST_NUM]        = { digit_append,  digit_append,  point_append,
+                        binary_apply,  special_apply, clear_all,
+                        ignore,        ignore },
+    [ST_ZERO]       = { ignore,        digit_append,  point_append,
+                        binary_apply,  special_apply, clear_all,
+                        ignore,        ignore },
+    [ST_ERROR]      = { digit_restart, digit_restart, point_restart,
+                        binary_apply,  special_apply, clear_all,
+                        ignore,        ignore },
+    [ST_OP]         = { digit_start,   digit_start,   ignore,
+                        binary_apply,  ignore,        clear_all,
+                        ignore,        ignore },
+    [ST_ENTRY]      = { digit_append,  digit_append,  point_add,
+                        binary_apply,  special_apply, clear_all,
+                        back_erase,    ignore },
+    [ST_ENTRY_ZERO] = { ignore,        digit_append,  point_add,
+                        binary_apply,  special_apply, clear_all,
+                        ignore,        ignore }
+};
+
+void engine_key(Engine *engine, key k)
+{
+    if ((unsigned)k > KEY_NONE) k = KEY_NONE;
+    transitions[engine->state][events[k]](engine, k);
+}
+
+/* Handles numerical input into calculator */
+void engine_digit(Engine *engine, int digit)
+{
+    engine_key(engine, (key)(KEY_0 + digit));
+}
+
+/* Handles unary operator inputs */
+void engine_special(Engine *engine, special op)
+{
+    engine_key(engine, (key)(KEY_FAC + op));
+}
+
+/* Handles the (.) button */
+void engine_point(Engine *engine)
+{
+    engine_key(engine, KEY_POINT);
+}
+
+/* Handles binary operator inputs, as well as "=" (op is DEFAULT) */
+void engine_binary(Engine *engine, operator op)
+{
+    engine_key(engine, (key)(KEY_DIV + op));
+}
+
+/* Clears and resets the calculator */
+void engine_clear(Engine *engine)
+{
+    engine_key(engine, KEY_CLEAR);
+}
+
+const char *engine_display(Engine *engine)
+{
+    if (!engine->stale) return engine->text;
+
+    if (engine->state == ST_OP) {
+        snprintf(engine->text, DISPLAY_LEN, "%s", op_to_str(engine->op));
+    }
+    else if (is_entry(engine->state)) {
+        entry_text(&engine->entry, engine->text);
+    }
+    else {
+        format_num(engine->text, DISPLAY_LEN, engine->num, TOT_DIGITS);
+    }
+
+    engine->stale = false;
+    return engine->text;
+}
+
+double engine_value(const Engine *engine)
+{
+    if (is_entry(engine->state)) return entry_value(&engine->entry);
+    return engine->num;
+}
+
+void engine_set_value(Engine *engine, double value)
+{
+    engine->num = value;
+    show_num(engine);
+}
+
+size_t engine_batch(Engine *engine, const key *keys, size_t n,
+                    double *results)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        engine_key(engine, keys[i]);
+        if (keys[i] == KEY_EQUALS) results[count++] = engine->num;
+    }
+    return count;
+}
+
+void engine_set_hook(Engine *engine, engine_hook hook, void *data)
+{
+    engine->hook = hook;
+    engine->hook_data = data;
+}
+
+/* Key of each ASCII character, plus one, so that the characters left out
+ * map to 0 and so to KEY_NONE. The keys in calc.ui, the keyboard and
+ * batch replays all go through this table. */
+static const unsigned char char_keys[128] = {
+    ['0'] = KEY_0 + 1, ['1'] = KEY_1 + 1, ['2'] = KEY_2 + 1,
+    ['3'] = KEY_3 + 1, ['4'] = KEY_4 + 1, ['5'] = KEY_5 + 1,
+    ['6'] = KEY_6 + 1, ['7'] = KEY_7 + 1, ['8'] = KEY_8 + 1,
+    ['9'] = KEY_9 + 1,
+    ['.'] = KEY_POINT + 1,
+    ['/'] = KEY_DIV + 1, ['*'] = KEY_MUL + 1, ['+'] = KEY_ADD + 1,
+    ['-'] = KEY_SUB + 1, ['='] = KEY_EQUALS + 1,
+    ['!'] = KEY_FAC + 1, ['r'] = KEY_SQT + 1, ['R'] = KEY_CBT + 1,
+    ['~'] = KEY_SGN + 1, ['%'] = KEY_PCT + 1,
+    ['q'] = KEY_SQR + 1, ['Q'] = KEY_CUB + 1,
+    ['s'] = KEY_SIN + 1, ['c'] = KEY_COS + 1, ['t'] = KEY_TAN + 1,
+    ['C'] = KEY_CLEAR + 1, ['\b'] = KEY_BACK + 1
+};
+
+key engine_char_key(char c)
+{
+    unsigned char u = (unsigned char)c;
+    if (u >= sizeof(char_keys) || char_keys[u] == 0) return KEY_NONE;
+    return (key)(char_keys[u] - 1);
+}
@@ -0,0 +1,145 @@
+/*********************** engine.h ***********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the calculator engine. The engine holds all
+ * of the calculator's arithmetic state and does not depend
+ * on GTK, so the same semantics can be driven by the GUI,
+ * by batch jobs and by benchmarks.
+ *
+ *******************************************************/
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "factorial.h"
+
+/* Enum representing binary operations, and default (no operation) */
+typedef enum {
+    DIV, MUL, ADD, SUB, DEFAULT
+} operator;
+
+/* Performs binary operation on a and b */
+#define bin_op(a, op, b) \
+    (((op) == DIV) ? ((a) / (b)) : \
+     ((op) == MUL) ? ((a) * (b)) : \
+     ((op) == ADD) ? ((a) + (b)) : \
+     ((op) == SUB) ? ((a) - (b)) : b)
+
+/* Given an operator, returns the ASCII character representing it, as a
+ * string, or the string "\0" if the operator is invalid or DEFAULT */
+#define op_to_str(op) \
+    (((op) == DIV) ? ("÷") : \
+     ((op) == MUL) ? ("\u00D7") : \
+     ((op) == ADD) ? ("+") : \
+     ((op) == SUB) ? ("-") : "\0")
+
+/* Given a string, returns the operator it represents. If the string
+ * does not represent an operator, returns the default operator */
+#define str_to_op(str) \
+    ((strcmp((str), ("÷")) == 0) ? (DIV) : \
+     (strcmp((str), ("\u00D7")) == 0) ? (MUL) : \
+     (strcmp((str), ("+")) == 0) ? (ADD) : \
+     (strcmp((str), ("-")) == 0) ? (SUB) : DEFAULT)
+
+/* Enum representing special unary operations */
+typedef enum {
+    FAC, SQT, CBT, SGN, PCT, SQR, CUB, SIN, COS, TAN, NUL
+} special;
+
+/* Performs binary operation on a and b */
+#define un_op(a, op) \
+    (((op) == FAC) ? (factorial(a)) : \
+     ((op) == SQT) ? (sqrt(a)) : \
+     ((op) == CBT) ? (cbrt(a)) : \
+     ((op) == SGN) ? (0 - (a)) : \
+     ((op) == PCT) ? ((a) / (float)100) : \
+     ((op) == SQR) ? ((a) * (a)) : \
+     ((op) == CUB) ? ((a) * (a) * (a)) : \
+     ((op) == SIN) ? (sin(a)) : \
+     ((op) == COS) ? (cos(a)) : \
+     ((op) == TAN) ? (tan(a)) : 0)
+
+#define str_to_special(str) \
+    ((strcmp((str), ("x!")) == 0) ? (FAC) : \
+     (strcmp((str), ("\u221Ax")) == 0) ? (SQT) : \
+     (strcmp((str), ("\u221Bx")) == 0) ? (CBT) : \
+     (strcmp((str), ("+/-")) == 0) ? (SGN) : \
+     (strcmp((str), ("%")) == 0) ? (PCT) : \
+     (strcmp((str), ("x²")) == 0) ? (SQR) : \
+     (strcmp((str), ("x³")) == 0) ? (CUB) : \
+     (strcmp((str), ("sin")) == 0) ? (SIN) : \
+     (strcmp((str), ("cos")) == 0) ? (COS) : \
+    (strcmp((str), ("tan")) == 0) ? (TAN) : NUL)
+
+/* Enum representing a single keystroke. Binary operator keys and special
+ * keys are laid out in the same order as the operator and special enums,
+ * so KEY_DIV + op and KEY_FAC + op map an operation to its key. */
+typedef enum {
+    KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9,
+    KEY_POINT,
+    KEY_DIV, KEY_MUL, KEY_ADD, KEY_SUB, KEY_EQUALS,
+    KEY_FAC, KEY_SQT, KEY_CBT, KEY_SGN, KEY_PCT,
+    KEY_SQR, KEY_CUB, KEY_SIN, KEY_COS, KEY_TAN,
+    KEY_CLEAR, KEY_BACK, KEY_NONE
+} key;
+
+/* Opaque handle to a calculator engine */
+typedef struct Engine Engine;
+
+/* Creates a cleared engine, or returns NULL if out of memory */
+Engine *engine_new(void);
+
+/* Frees an engine created by engine_new */
+void engine_free(Engine *engine);
+
+/* Keystroke handlers, one per kind of calculator button. Passing DEFAULT
+ * to engine_binary is the same as pressing "=". */
+void engine_digit(Engine *engine, int digit);
+void engine_point(Engine *engine);
+void engine_binary(Engine *engine, operator op);
+void engine_special(Engine *engine, special op);
+void engine_clear(Engine *engine);
+
+/* Feeds a single keystroke to the engine */
+void engine_key(Engine *engine, key k);
+
+/* Returns the text currently shown on the calculator's display. The
+ * string is owned by the engine and is valid until its next keystroke. */
+const char *engine_display(Engine *engine);
+
+/* Returns the number currently held by the engine */
+double engine_value(const Engine *engine);
+
+/* Makes value the number shown, in place of any number being typed, as if
+ * it had been typed; after "2 +" it becomes the right operand */
+void engine_set_value(Engine *engine, double value);
+
+/* Feeds n keystrokes to the engine. Every time "=" is processed the result
+ * is stored in results, which must have room for one value per KEY_EQUALS
+ * in keys. Returns the number of results stored. */
+size_t engine_batch(Engine *engine, const key *keys, size_t n,
+                    double *results);
+
+/* Maps an ASCII character to a keystroke, or KEY_NONE if it has none:
+ *   0-9 .        digits and decimal point
+ *   / * + - =    binary operators and equals
+ *   ! r R ~ %    factorial, square root, cube root, sign, percent
+ *   q Q s c t    square, cube, sine, cosine, tangent
+ *   C \b         clear, and erase the last character typed */
+key engine_char_key(char c);
+
+/* Function called after every binary operation the engine performs, with
+ * its operands and result: 2, ADD, 3 and 5 for "2 + 3". For "2 + 3 × 4 ="
+ * it is called for "2 + 3" and then for "5 × 4". */
+typedef void (*engine_hook)(void *data, double left, operator op,
+                            double right, double result);
+
+/* Makes the engine call hook with data after every binary operation, or
+ * stops it doing so if hook is NULL */
+void engine_set_hook(Engine *engine, engine_hook hook, void *data);
+
+#endif
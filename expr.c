@@ -0,0 +1,403 @@
+/************************ expr.c ************************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the expression
+ * compiler, a lexer and recursive descent parser which
+ * emit postfix bytecode, and of a simple evaluator for
+ * that bytecode.
+ *
+ *******************************************************/
+
+#include "expr.h"
+#include <stdlib.h>
+#include <string.h>
+#include "format.h"
+
+/* Deepest nesting of parentheses and prefix operators accepted */
+#define MAX_NESTING 64
+
+/* Enum representing the kinds of token in an expression */
+typedef enum {
+    TOK_NUM, TOK_VAR, TOK_OPEN, TOK_CLOSE,
+    TOK_ADD, TOK_SUB, TOK_MUL, TOK_DIV,
+    TOK_FAC, TOK_PCT, TOK_SQR, TOK_CUB,
+    TOK_SQT, TOK_CBT, TOK_SIN, TOK_COS, TOK_TAN,
+    TOK_END, TOK_BAD
+} token;
+
+/* State of the compiler while it walks over the text */
+typedef struct Parser {
+    const char *text; /* Expression being compiled */
+    size_t len;       /* Length of text */
+    size_t pos;       /* Position just after the current token */
+    size_t tok_pos;   /* Position of the current token */
+    token tok;        /* Current token */
+    double num;       /* Value of the current token, if it is TOK_NUM */
+    int depth;        /* Current depth of the evaluation stack */
+    int nesting;      /* Current nesting of recursive rules */
+    bool no_var;      /* Is true if the variable x is an error */
+    Program *prog;    /* Program being emitted */
+    ExprError error;  /* First error found, msg is NULL if none */
+} Parser;
+
+static void parse_sum(Parser *p);
+
+/* Records an error at the current token, keeping the first one */
+static void fail(Parser *p, const char *msg)
+{
+    if (p->error.msg != NULL) return;
+    p->error.pos = p->tok_pos;
+    p->error.msg = msg;
+}
+
+/* Reads a numeric literal such as 2, 2.5, .5 or 1e-3 starting at tok_pos.
+ * Returns TOK_NUM, or TOK_BAD if there is no digit */
+static token lex_number(Parser *p)
+{
+    const char *s = p->text;
+    size_t i = p->tok_pos;
+    char digits[FMT_PARSE_MAX];
+    int len = 0, exponent = 0;
+    bool seen = false; /* is true once any digit has been read */
+
+    /* digits are copied without the decimal point; each one after the
+     * point divides the value by ten */
+    for (bool point = false; i < p->len; i++) {
+        if (s[i] == '.' && !point) {
+            point = true;
+            continue;
+        }
+        if (s[i] < '0' || s[i] > '9') break;
+
+        seen = true;
+        if (len == 0 && s[i] == '0') {
+            if (point) exponent--; /* leading zero */
+            continue;
+        }
+        if (len == FMT_PARSE_MAX) {
+            fail(p, "number is too long");
+            return TOK_BAD;
+        }
+        digits[len++] = s[i];
+        if (point) exponent--;
+    }
+    if (!seen) return TOK_BAD;
+
+    /* optional exponent, only consumed if digits follow it */
+    if (i < p->len && (s[i] == 'e' || s[i] == 'E')) {
+        size_t j = i + 1;
+        bool negative = (j < p->len && s[j] == '-');
+        if (j < p->len && (s[j] == '+' || s[j] == '-')) j++;
+
+        if (j < p->len && s[j] >= '0' && s[j] <= '9') {
+            int e = 0;
+            for (; j < p->len && s[j] >= '0' && s[j] <= '9'; j++) {
+                if (e < 100000) e = e * 10 + (s[j] - '0');
+            }
+            exponent += negative ? -e : e;
+            i = j;
+        }
+    }
+
+    p->pos = i;
+    p->num = format_parse(digits, len, exponent);
+    return TOK_NUM;
+}
+
+/* Reads a name such as "sin" or "x" starting at tok_pos */
+static token lex_name(Parser *p)
+{
+    static const struct { const char *name; token tok; } names[] = {
+        { "x", TOK_VAR }, { "sqrt", TOK_SQT }, { "cbrt", TOK_CBT },
+        { "sin", TOK_SIN }, { "cos", TOK_COS }, { "tan", TOK_TAN }
+    };
+    size_t end = p->tok_pos;
+
+    while (end < p->len && p->text[end] >= 'a' && p->text[end] <= 'z') {
+        end++;
+    }
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        size_t n = strlen(names[i].name);
+        if (end - p->tok_pos == n &&
+            memcmp(p->text + p->tok_pos, names[i].name, n) == 0) {
+            p->pos = end;
+            return names[i].tok;
+        }
+    }
+    return TOK_BAD;
+}
+
+/* Reads a two or three byte UTF-8 symbol such as "×" or "√" starting at
+ * tok_pos */
+static token lex_symbol(Parser *p)
+{
+    static const struct { const char *symbol; token tok; } symbols[] = {
+        { "×", TOK_MUL }, { "÷", TOK_DIV }, { "−", TOK_SUB },
+        { "²", TOK_SQR }, { "³", TOK_CUB }, { "√", TOK_SQT },
+        { "∛", TOK_CBT }
+    };
+
+    for (size_t i = 0; i < sizeof(symbols) / sizeof(*symbols); i++) {
+        size_t n = strlen(symbols[i].symbol);
+        if (p->len - p->tok_pos >= n &&
+            memcmp(p->text + p->tok_pos, symbols[i].symbol, n) == 0) {
+            p->pos = p->tok_pos + n;
+            return symbols[i].tok;
+        }
+    }
+    return TOK_BAD;
+}
+
+/* Moves on to the next token */
+static void next(Parser *p)
+{
+    const char *s = p->text;
+    size_t i = p->pos;
+
+    while (i < p->len &&
+           (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) {
+        i++;
+    }
+    p->tok_pos = i;
+    p->pos = i + 1;
+
+    if (i == p->len) {
+        p->pos = i;
+        p->tok = TOK_END;
+        return;
+    }
+
+    switch (s[i]) {
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+        case '.': p->tok = lex_number(p); break;
+        case '(': p->tok = TOK_OPEN;      break;
+        case ')': p->tok = TOK_CLOSE;     break;
+        case '+': p->tok = TOK_ADD;       break;
+        case '-': p->tok = TOK_SUB;       break;
+        case '*': p->tok = TOK_MUL;       break;
+        case '/': p->tok = TOK_DIV;       break;
+        case '!': p->tok = TOK_FAC;       break;
+        case '%': p->tok = TOK_PCT;       break;
+        default:
+            if (s[i] >= 'a' && s[i] <= 'z') {
+                p->tok = lex_name(p);
+            } else if ((unsigned char)s[i] >= 0x80) {
+                p->tok = lex_symbol(p);
+            } else {
+                p->tok = TOK_BAD;
+            }
+    }
+}
+
+/* Appends an instruction, tracking how it changes the stack depth */
+static void emit(Parser *p, opcode op)
+{
+    Program *prog = p->prog;
+
+    if (prog->len == EXPR_MAX_CODE) {
+        fail(p, "expression is too long");
+        return;
+    }
+    prog->code[prog->len++] = (unsigned char)op;
+
+    if (op == OP_NUM || op == OP_VAR) {
+        p->depth++;
+        if (p->depth > prog->depth) prog->depth = p->depth;
+        if (prog->depth > EXPR_MAX_DEPTH) fail(p, "expression is too deep");
+    }
+    else if (op <= OP_SUB) {
+        p->depth--;
+    }
+}
+
+/* Appends an instruction pushing the constant num */
+static void emit_num(Parser *p, double num)
+{
+    Program *prog = p->prog;
+
+    if (prog->nconsts == EXPR_MAX_CONSTS) {
+        fail(p, "expression has too many numbers");
+        return;
+    }
+    prog->consts[prog->nconsts++] = num;
+    emit(p, OP_NUM);
+}
+
+/* Parses a number, the variable x or a parenthesized expression */
+static void parse_primary(Parser *p)
+{
+    switch (p->tok) {
+        case TOK_NUM:
+            emit_num(p, p->num);
+            next(p);
+            break;
+        case TOK_VAR:
+            if (p->no_var) {
+                fail(p, "x has no value outside column mode");
+                return;
+            }
+            emit(p, OP_VAR);
+            next(p);
+            break;
+        case TOK_OPEN:
+            next(p);
+            parse_sum(p);
+            if (p->tok != TOK_CLOSE) {
+                fail(p, "expected \")\"");
+                return;
+            }
+            next(p);
+            break;
+        default:
+            fail(p, "expected a number");
+    }
+}
+
+/* Parses a primary followed by any number of postfix operators */
+static void parse_postfix(Parser *p)
+{
+    parse_primary(p);
+
+    while (p->error.msg == NULL) {
+        if (p->tok == TOK_FAC)      emit(p, OP_FAC);
+        else if (p->tok == TOK_PCT) emit(p, OP_PCT);
+        else if (p->tok == TOK_SQR) emit(p, OP_SQR);
+        else if (p->tok == TOK_CUB) emit(p, OP_CUB);
+        else break;
+        next(p);
+    }
+}
+
+/* Parses any number of prefix operators followed by a postfix term */
+static void parse_unary(Parser *p)
+{
+    opcode op;
+
+    /* a unary plus is parsed but emits nothing, marked here by OP_END */
+    switch (p->tok) {
+        case TOK_SUB: op = OP_SGN; break;
+        case TOK_ADD: op = OP_END; break;
+        case TOK_SQT: op = OP_SQT; break;
+        case TOK_CBT: op = OP_CBT; break;
+        case TOK_SIN: op = OP_SIN; break;
+        case TOK_COS: op = OP_COS; break;
+        case TOK_TAN: op = OP_TAN; break;
+        default:
+            parse_postfix(p);
+            return;
+    }
+
+    if (++p->nesting > MAX_NESTING) {
+        fail(p, "expression is nested too deeply");
+        return;
+    }
+    next(p);
+    parse_unary(p);
+    p->nesting--;
+
+    if (op != OP_END) emit(p, op);
+}
+
+/* Parses a product or quotient of unary terms */
+static void parse_product(Parser *p)
+{
+    parse_unary(p);
+
+    while (p->error.msg == NULL &&
+           (p->tok == TOK_MUL || p->tok == TOK_DIV)) {
+        opcode op = (p->tok == TOK_MUL) ? OP_MUL : OP_DIV;
+        next(p);
+        parse_unary(p);
+        emit(p, op);
+    }
+}
+
+/* Parses a sum or difference of products */
+static void parse_sum(Parser *p)
+{
+    if (++p->nesting > MAX_NESTING) {
+        fail(p, "expression is nested too deeply");
+        return;
+    }
+
+    parse_product(p);
+
+    while (p->error.msg == NULL &&
+           (p->tok == TOK_ADD || p->tok == TOK_SUB)) {
+        opcode op = (p->tok == TOK_ADD) ? OP_ADD : OP_SUB;
+        next(p);
+        parse_product(p);
+        emit(p, op);
+    }
+
+    p->nesting--;
+}
+
+/* Compiles text as expr_compile does; if no_var is true, x is an error */
+static bool compile(Program *prog, const char *text, size_t len,
+                    bool no_var, ExprError *error)
+{
+    Parser p = { 0 };
+    p.text = text;
+    p.len = len;
+    p.prog = prog;
+    p.no_var = no_var;
+
+    prog->len = 0;
+    prog->nconsts = 0;
+    prog->depth = 0;
+
+    next(&p);
+    parse_sum(&p);
+    if (p.tok != TOK_END) fail(&p, "unexpected character");
+
+    emit(&p, OP_END);
+
+    if (p.error.msg != NULL) {
+        if (error != NULL) *error = p.error;
+        return false;
+    }
+    return true;
+}
+
+bool expr_compile(Program *prog, const char *text, size_t len,
+                  ExprError *error)
+{
+    return compile(prog, text, len, false, error);
+}
+
+bool expr_compile_const(Program *prog, const char *text, size_t len,
+                        ExprError *error)
+{
+    return compile(prog, text, len, true, error);
+}
+
+double expr_eval(const Program *prog, double x)
+{
+    double stack[EXPR_MAX_DEPTH];
+    const double *constant = prog->consts;
+    int top = -1;
+
+    for (const unsigned char *pc = prog->code; ; pc++) {
+        opcode op = (opcode)*pc;
+
+        if (op == OP_NUM) {
+            stack[++top] = *constant++;
+        }
+        else if (op == OP_VAR) {
+            stack[++top] = x;
+        }
+        else if (op <= OP_SUB) {
+            top--;
+            stack[top] = bin_op(stack[top], op - OP_DIV, stack[top + 1]);
+        }
+        else if (op <= OP_TAN) {
+            stack[top] = un_op(stack[top], op - OP_FAC);
+        }
+        else {
+            return stack[0];
+        }
+    }
+}
@@ -0,0 +1,77 @@
+/************************ expr.h ************************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the expression compiler. Expressions such
+ * as "2 + 3 × 4" are compiled once, with the usual operator
+ * precedence, into a flat bytecode program which can then
+ * be evaluated any number of times.
+ *
+ *******************************************************/
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "engine.h"
+
+/* Limits on the size of a compiled program */
+#define EXPR_MAX_CODE 256   /* instructions */
+#define EXPR_MAX_CONSTS 128 /* numeric literals */
+#define EXPR_MAX_DEPTH 32   /* values on the evaluation stack */
+
+/* Enum representing bytecode instructions. Binary and unary instructions
+ * are laid out in the same order as the operator and special enums, so
+ * OP_DIV + op and OP_FAC + op map an operation to its instruction. */
+typedef enum {
+    OP_NUM, /* pushes the program's next constant */
+    OP_VAR, /* pushes the value of the variable x */
+    OP_DIV, OP_MUL, OP_ADD, OP_SUB,
+    OP_FAC, OP_SQT, OP_CBT, OP_SGN, OP_PCT,
+    OP_SQR, OP_CUB, OP_SIN, OP_COS, OP_TAN,
+    OP_END
+} opcode;
+
+/* A compiled expression. Constants are consumed in order by OP_NUM, so
+ * instructions need no operands. Programs hold no pointers and can be
+ * copied freely. */
+typedef struct Program {
+    int len;     /* Number of instructions, including OP_END */
+    int nconsts; /* Number of constants */
+    int depth;   /* Deepest evaluation stack the program needs */
+    unsigned char code[EXPR_MAX_CODE];
+    double consts[EXPR_MAX_CONSTS];
+} Program;
+
+/* Describes why an expression failed to compile */
+typedef struct ExprError {
+    size_t pos;      /* Byte offset into the expression text */
+    const char *msg; /* Static description of the error */
+} ExprError;
+
+/* Compiles the first len bytes of text into prog. The text need not be
+ * NUL-terminated. Returns true on success; otherwise returns false and,
+ * if error is not NULL, fills it in.
+ *
+ * Accepted syntax, from loosest to tightest binding:
+ *   a + b   a - b                   addition, subtraction
+ *   a × b   a * b   a ÷ b   a / b   multiplication, division
+ *   -a   +a   √a   sqrt a   ∛a   cbrt a   sin a   cos a   tan a
+ *   a!   a%   a²   a³               factorial, percent, square, cube
+ *   (a)                             parentheses
+ *   2   2.5   .5   1e-3             numbers
+ *   x                               the variable x */
+bool expr_compile(Program *prog, const char *text, size_t len,
+                  ExprError *error);
+
+/* Same as expr_compile, but the variable x is an error, reported at the
+ * x. For expressions evaluated on their own, where x has no value. */
+bool expr_compile_const(Program *prog, const char *text, size_t len,
+                        ExprError *error);
+
+/* Evaluates a compiled program instruction by instruction with the bin_op
+ * and un_op macros, with the variable x set to x. This is the reference
+ * for vm_eval in vm.h, which gives the same results faster. */
+double expr_eval(const Program *prog, double x);
+
+#endif
@@ -0,0 +1,22 @@
+/********************** factorial.h *********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the factorial function used by the x! key
+ * and the ! operator.
+ *
+ *******************************************************/
+
+#ifndef FACTORIAL_H
+#define FACTORIAL_H
+
+/* Largest n whose factorial is finite as a double */
+#define FACTORIAL_MAX 170
+
+/* Returns a!, extended to non-integers as gamma(a + 1). For the integers 0
+ * to FACTORIAL_MAX the result is exact, or the nearest double if n! has
+ * more than 53 significant bits, and comes from a table; larger integers
+ * give inf. Everything else, including negative integers, is tgamma(a + 1).
+ */
+double factorial(double a);
+
+#endif
@@ -0,0 +1,548 @@
+/*********************** format.c ***********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the number
+ * formatter. The digits come from Florian Loitsch's Grisu2
+ * algorithm ("Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers", PLDI 2010), which works with
+ * 64-bit integers and a table of cached powers of ten. The
+ * digits it produces always read back as the same double,
+ * and are the shortest such digits in nearly every case.
+ *
+ *******************************************************/
+
+#include "format.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h> /* for the isinf, isnan and signbit macros only */
+
+/* A floating point number f × 2^e with a 64-bit significand */
+typedef struct DiyFp {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+/* Layout of an IEEE 754 double */
+#define DP_SIGNIFICAND_BITS 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_BITS)
+#define DP_MIN_EXPONENT (-DP_EXPONENT_BIAS + 1)
+#define DP_HIDDEN_BIT ((uint64_t)1 << DP_SIGNIFICAND_BITS)
+#define DP_SIGNIFICAND_MASK (DP_HIDDEN_BIT - 1)
+#define DP_EXPONENT_MASK ((uint64_t)0x7FF << DP_SIGNIFICAND_BITS)
+#define DP_SIGN_MASK ((uint64_t)1 << 63)
+
+/* Normalized 10^k for k = -348, -340, ..., 340, as significands and
+ * binary exponents, rounded to nearest */
+static const uint64_t cached_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t cached_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+/* Powers of ten that fit in 64 bits */
+static const uint64_t pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+/* Powers of ten that are exact as doubles */
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Returns the bits of a double */
+static uint64_t double_bits(double num)
+{
+    uint64_t bits;
+    memcpy(&bits, &num, sizeof(bits));
+    return bits;
+}
+
+#ifdef __SIZEOF_INT128__
+
+/* Returns a × b, rounded to 64 bits */
+static DiyFp multiply(DiyFp a, DiyFp b)
+{
+    unsigned __int128 p = (unsigned __int128)a.f * b.f;
+    uint64_t high = (uint64_t)(p >> 64);
+    uint64_t low = (uint64_t)p;
+
+    if (low & DP_SIGN_MASK) high++; /* round */
+    return (DiyFp){ high, a.e + b.e + 64 };
+}
+
+/* Shifts x left until its top bit is set */
+static DiyFp normalize(DiyFp x)
+{
+    int shift = __builtin_clzll(x.f);
+    return (DiyFp){ x.f << shift, x.e - shift };
+}
+
+#else
+
+/* Returns a × b, rounded to 64 bits, from the products of their 32-bit
+ * halves, for targets without a 128-bit integer type */
+static DiyFp multiply(DiyFp a, DiyFp b)
+{
+    const uint64_t mask = 0xFFFFFFFFu;
+    uint64_t ah = a.f >> 32, al = a.f & mask;
+    uint64_t bh = b.f >> 32, bl = b.f & mask;
+    uint64_t hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+
+    /* bits 32 to 95 of the product, plus half of bit 64 to round */
+    uint64_t mid = (ll >> 32) + (hl & mask) + (lh & mask);
+    mid += (uint64_t)1 << 31;
+
+    return (DiyFp){ hh + (hl >> 32) + (lh >> 32) + (mid >> 32),
+                    a.e + b.e + 64 };
+}
+
+/* Shifts x left until its top bit is set */
+static DiyFp normalize(DiyFp x)
+{
+    while (!(x.f & DP_SIGN_MASK)) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+#endif
+
+/* Sets v to the finite, positive number num, and minus and plus to the
+ * boundaries halfway to its neighbours, all scaled to the same exponent
+ * as the normalized plus */
+static void boundaries(double num, DiyFp *v, DiyFp *minus, DiyFp *plus)
+{
+    uint64_t bits = double_bits(num);
+    uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+    int biased_e = (int)((bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_BITS);
+
+    if (biased_e != 0) {
+        v->f = significand + DP_HIDDEN_BIT;
+        v->e = biased_e - DP_EXPONENT_BIAS;
+    }
+    else { /* subnormal */
+        v->f = significand;
+        v->e = DP_MIN_EXPONENT;
+    }
+
+    *plus = normalize((DiyFp){ (v->f << 1) + 1, v->e - 1 });
+
+    /* the gap below a power of two is half the gap above it */
+    if (v->f == DP_HIDDEN_BIT) {
+        *minus = (DiyFp){ (v->f << 2) - 1, v->e - 2 };
+    } else {
+        *minus = (DiyFp){ (v->f << 1) - 1, v->e - 1 };
+    }
+    minus->f <<= minus->e - plus->e;
+    minus->e = plus->e;
+
+    *v = normalize(*v);
+}
+
+/* Returns the cached power of ten c = 10^-k which brings a number with
+ * binary exponent e into the range Grisu needs, and sets k */
+static DiyFp cached_power(int e, int *k)
+{
+    /* smallest decimal exponent giving a product exponent of at least -61;
+     * 0.30102999566398114 is log10(2) */
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int)dk;
+    if (dk - ik > 0.0) ik++;
+
+    unsigned index = (unsigned)((ik >> 3) + 1);
+    *k = -(-348 + (int)index * 8);
+    return (DiyFp){ cached_f[index], cached_e[index] };
+}
+
+/* Moves the last digit of the len digits in buf towards the exact value
+ * while the result stays inside the rounding interval */
+static void round_weed(char *buf, int len, uint64_t delta, uint64_t rest,
+                       uint64_t ten_kappa, uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w ||
+            wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+/* Returns the number of decimal digits in n */
+static int count_digits(uint32_t n)
+{
+    int digits = 1;
+    while (digits < 10 && n >= pow10[digits]) digits++;
+    return digits;
+}
+
+/* Generates the digits of w, which lies somewhere below mp and within
+ * delta of it, into buf. Sets len, and adjusts the decimal exponent k */
+static void digit_gen(DiyFp w, DiyFp mp, uint64_t delta, char *buf,
+                      int *len, int *k)
+{
+    DiyFp one = { (uint64_t)1 << -mp.e, mp.e };
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e); /* integral part */
+    uint64_t p2 = mp.f & (one.f - 1);         /* fractional part */
+    int kappa = count_digits(p1);
+
+    *len = 0;
+    while (kappa > 0) {
+        uint32_t d;
+
+        /* constant divisors let the compiler multiply instead of divide */
+        switch (kappa) {
+            case 10: d = p1 / 1000000000; p1 %= 1000000000; break;
+            case 9:  d = p1 / 100000000;  p1 %= 100000000;  break;
+            case 8:  d = p1 / 10000000;   p1 %= 10000000;   break;
+            case 7:  d = p1 / 1000000;    p1 %= 1000000;    break;
+            case 6:  d = p1 / 100000;     p1 %= 100000;     break;
+            case 5:  d = p1 / 10000;      p1 %= 10000;      break;
+            case 4:  d = p1 / 1000;       p1 %= 1000;       break;
+            case 3:  d = p1 / 100;        p1 %= 100;        break;
+            case 2:  d = p1 / 10;         p1 %= 10;         break;
+            default: d = p1;              p1 = 0;           break;
+        }
+        if (d || *len) buf[(*len)++] = (char)('0' + d);
+        kappa--;
+
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *k += kappa;
+            round_weed(buf, *len, delta, rest, pow10[kappa] << -one.e,
+                       wp_w);
+            return;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || *len) buf[(*len)++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+
+        if (p2 < delta) {
+            *k += kappa;
+            int index = -kappa;
+            round_weed(buf, *len, delta, p2, one.f,
+                       wp_w * (index < 20 ? pow10[index] : 0));
+            return;
+        }
+    }
+}
+
+/* Writes the shortest digits of the finite, positive number num into
+ * digits, without a decimal point. Returns how many there are, and sets
+ * point to the position of the decimal point relative to the first digit:
+ * num = 0.d1d2d3... × 10^point */
+static int shortest_digits(double num, char *digits, int *point)
+{
+    DiyFp v, minus, plus;
+    int len, k;
+
+    boundaries(num, &v, &minus, &plus);
+    DiyFp c = cached_power(plus.e, &k);
+    DiyFp w = multiply(v, c);
+    DiyFp wp = multiply(plus, c);
+    DiyFp wm = multiply(minus, c);
+
+    /* shrink the interval by one unit to stay clear of rounding errors */
+    wm.f++;
+    wp.f--;
+    digit_gen(w, wp, wp.f - wm.f, digits, &len, &k);
+
+    *point = len + k;
+    return len;
+}
+
+/* Rounds the len digits in digits to the first keep of them, rounding
+ * halves up. Returns the new number of digits; if every kept digit was 9,
+ * or none was kept, the result is the single digit 1 and point moves up */
+static int round_at(char *digits, int len, int keep, int *point)
+{
+    if (len <= keep) return len;
+    if (keep < 0) return 0;
+
+    if (digits[keep] >= '5') {
+        int i = keep;
+        while (i > 0 && digits[i - 1] == '9') digits[--i] = '0';
+
+        if (i == 0) {
+            digits[0] = '1';
+            (*point)++;
+            return 1;
+        }
+        digits[i - 1]++;
+    }
+    return keep;
+}
+
+/* Writes count copies of c to buf, returning the position after them */
+static char *repeat(char *buf, char c, int count)
+{
+    for (int i = 0; i < count; i++) *buf++ = c;
+    return buf;
+}
+
+/* Writes a decimal exponent such as "e+20" or "e-9" to buf, returning the
+ * position after it */
+static char *write_exponent(char *buf, int exponent)
+{
+    *buf++ = 'e';
+    if (exponent < 0) {
+        *buf++ = '-';
+        exponent = -exponent;
+    } else {
+        *buf++ = '+';
+    }
+
+    if (exponent >= 100) *buf++ = (char)('0' + exponent / 100);
+    if (exponent >= 10) *buf++ = (char)('0' + exponent / 10 % 10);
+    *buf++ = (char)('0' + exponent % 10);
+    return buf;
+}
+
+/* Writes the text for zero, infinity and NaN. Returns its length, or -1 if
+ * num is some other number */
+static int format_special(char *buf, double num)
+{
+    uint64_t bits = double_bits(num);
+    const char *text;
+
+    if ((bits & ~DP_SIGN_MASK) == 0) {
+        text = "0";
+    }
+    else if ((bits & DP_EXPONENT_MASK) != DP_EXPONENT_MASK) {
+        return -1;
+    }
+    else if (bits & DP_SIGNIFICAND_MASK) {
+        text = "nan";
+    }
+    else {
+        text = (bits & DP_SIGN_MASK) ? "-inf" : "inf";
+    }
+
+    size_t len = strlen(text);
+    memcpy(buf, text, len + 1);
+    return (int)len;
+}
+
+/* Writes the text for format_num into buf, which holds FMT_LEN characters */
+static int write_num(char *buf, double num, int max_digits)
+{
+    int len = format_special(buf, num);
+    if (len >= 0) return len;
+
+    char digits[FMT_MAX_DIGITS + 2];
+    int point;
+    char *out = buf;
+
+    if (max_digits < 1) max_digits = 1;
+    if (max_digits > FMT_MAX_DIGITS) max_digits = FMT_MAX_DIGITS;
+
+    if (num < 0) {
+        *out++ = '-';
+        num = -num;
+    }
+
+    len = shortest_digits(num, digits, &point);
+    len = round_at(digits, len, max_digits, &point);
+    while (len > 1 && digits[len - 1] == '0') len--;
+
+    /* use an exponent when the number has too many leading or trailing
+     * zeros, the same rule printf's %g follows */
+    int exponent = point - 1;
+    if (exponent < -4 || exponent >= max_digits) {
+        *out++ = digits[0];
+        if (len > 1) {
+            *out++ = '.';
+            memcpy(out, digits + 1, len - 1);
+            out += len - 1;
+        }
+        out = write_exponent(out, exponent);
+    }
+    else if (point <= 0) { /* 0.000ddd */
+        *out++ = '0';
+        *out++ = '.';
+        out = repeat(out, '0', -point);
+        memcpy(out, digits, len);
+        out += len;
+    }
+    else if (point >= len) { /* ddd000 */
+        memcpy(out, digits, len);
+        out = repeat(out + len, '0', point - len);
+    }
+    else { /* ddd.ddd */
+        memcpy(out, digits, point);
+        out += point;
+        *out++ = '.';
+        memcpy(out, digits + point, len - point);
+        out += len - point;
+    }
+
+    *out = '\0';
+    return (int)(out - buf);
+}
+
+double format_parse(const char *digits, int len, int exponent)
+{
+    int i = 0;
+    while (i < len && digits[i] == '0') i++; /* leading zeros */
+    if (i == len) return 0;
+
+    /* Clinger's fast path: both the significand and the power of ten are
+     * exact doubles, so one rounding gives the correctly rounded result */
+    if (len - i <= 15 && exponent >= -22 && exponent <= 22) {
+        uint64_t m = 0;
+        for (; i < len; i++) m = m * 10 + (uint64_t)(digits[i] - '0');
+
+        if (exponent < 0) return (double)m / exact_pow10[-exponent];
+        return (double)m * exact_pow10[exponent];
+    }
+
+    /* beyond this every result is zero or infinity anyway */
+    if (exponent > 999) exponent = 999;
+    if (exponent < -999) exponent = -999;
+
+    char text[FMT_PARSE_MAX + 8];
+    memcpy(text, digits + i, len - i);
+    char *end = write_exponent(text + (len - i), exponent);
+    *end = '\0';
+    return strtod(text, NULL);
+}
+
+/* Copies the len characters of text, which come from a write function, to
+ * a caller's buffer of size characters, cutting them short if needed */
+static int copy_out(char *buf, size_t size, const char *text, int len)
+{
+    if (size > 0) {
+        size_t n = ((size_t)len < size) ? (size_t)len : size - 1;
+        memcpy(buf, text, n);
+        buf[n] = '\0';
+    }
+    return len;
+}
+
+int format_num(char *buf, size_t size, double num, int max_digits)
+{
+    if (size >= FMT_LEN) return write_num(buf, num, max_digits);
+
+    char text[FMT_LEN];
+    return copy_out(buf, size, text, write_num(text, num, max_digits));
+}
+
+void format_arena_init(FormatArena *arena)
+{
+    memset(arena, 0, sizeof(*arena));
+}
+
+void format_arena_reset(FormatArena *arena)
+{
+    arena->count = 0;
+    arena->len = 0;
+}
+
+void format_arena_free(FormatArena *arena)
+{
+    free(arena->text);
+    free(arena->offsets);
+    format_arena_init(arena);
+}
+
+/* Makes room in the arena for n more numbers of any length. Returns false
+ * if out of memory */
+static bool reserve(FormatArena *arena, size_t n)
+{
+    /* the worst case is FMT_LEN - 1 characters plus a separator each */
+    size_t text_need = arena->len + n * FMT_LEN;
+    size_t count_need = arena->count + n + 1;
+
+    if (text_need > arena->text_cap) {
+        size_t cap = (arena->text_cap * 2 > text_need) ? arena->text_cap * 2
+                                                       : text_need;
+        char *text = realloc(arena->text, cap);
+        if (text == NULL) return false;
+        arena->text = text;
+        arena->text_cap = cap;
+    }
+
+    if (count_need > arena->count_cap) {
+        size_t cap = (arena->count_cap * 2 > count_need)
+                         ? arena->count_cap * 2 : count_need;
+        size_t *offsets = realloc(arena->offsets, cap * sizeof(size_t));
+        if (offsets == NULL) return false;
+        arena->offsets = offsets;
+        arena->count_cap = cap;
+    }
+    return true;
+}
+
+bool format_bulk(FormatArena *arena, const double *nums, size_t n,
+                 int max_digits, char sep)
+{
+    if (!reserve(arena, n)) return false;
+
+    char *text = arena->text;
+    size_t *offsets = arena->offsets + arena->count;
+    size_t len = arena->len;
+
+    for (size_t i = 0; i < n; i++) {
+        offsets[i] = len;
+        len += write_num(text + len, nums[i], max_digits);
+        text[len++] = sep;
+    }
+    offsets[n] = len;
+
+    arena->count += n;
+    arena->len = len;
+    return true;
+}
@@ -0,0 +1,73 @@
+/*********************** format.h ***********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the number formatter, which turns doubles
+ * into the shortest text that reads back as the same
+ * number, in a single pass and without calling libm.
+ *
+ *******************************************************/
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Most significant digits any double needs to be read back exactly */
+#define FMT_MAX_DIGITS 17
+
+/* Size of a buffer which can hold any text written below, including the
+ * terminating NUL */
+#define FMT_LEN 40
+
+/* All functions below write only to memory supplied by the caller, so they
+ * can be called from any number of threads at once. Like snprintf, they
+ * write at most size characters including the NUL, and return the length
+ * of the complete text, so a return value of size or more means the text
+ * was cut short. A buffer of FMT_LEN characters is always large enough. */
+
+/* Writes the shortest text that reads back as num, rounded to at most
+ * max_digits significant digits. Very large and very small numbers use
+ * exponent notation, for example "1.5e+20" and "1e-9". */
+int format_num(char *buf, size_t size, double num, int max_digits);
+
+/* Most digits format_parse accepts */
+#define FMT_PARSE_MAX 64
+
+/* Returns the double nearest to the decimal number made of the len digits
+ * at digits, times 10 to the power exponent. For example, the digits "250"
+ * with exponent -2 give 2.5. len must be at most FMT_PARSE_MAX. When the
+ * digits fit in 53 bits and the exponent is small, the result comes from a
+ * single exact multiplication or division; otherwise strtod is used. */
+double format_parse(const char *digits, int len, int exponent);
+
+/* Growable storage for many formatted numbers stored back to back, each
+ * followed by a separator character. The i-th text starts at
+ * text + offsets[i] and is offsets[i + 1] - offsets[i] - 1 characters
+ * long, not counting its separator. */
+typedef struct FormatArena {
+    char *text;       /* Formatted numbers and separators */
+    size_t *offsets;  /* Start of each number, plus the end of the last */
+    size_t count;     /* Number of numbers stored */
+    size_t len;       /* Characters used in text */
+    size_t text_cap;  /* Characters allocated for text */
+    size_t count_cap; /* Numbers offsets has room for */
+} FormatArena;
+
+/* Initializes an empty arena */
+void format_arena_init(FormatArena *arena);
+
+/* Empties an arena, keeping its memory for reuse */
+void format_arena_reset(FormatArena *arena);
+
+/* Frees the memory held by an arena, leaving it empty */
+void format_arena_free(FormatArena *arena);
+
+/* Appends the n numbers in nums to the arena, formatted as by format_num
+ * and each followed by sep. Use '\n' to get output ready to be written out
+ * in one go, or '\0' to get C strings. The arena grows at most once per
+ * call. Returns false, leaving the arena unchanged, if out of memory. */
+bool format_bulk(FormatArena *arena, const double *nums, size_t n,
+                 int max_digits, char sep);
+
+#endif
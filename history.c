@@ -0,0 +1,202 @@
+/*********************** history.c **********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the history
+ * tape. The file starts with a header holding the number
+ * of entries, followed by room for a power of two entries.
+ * An entry is written into the mapping, then counted, so
+ * a crash never leaves a half-written entry counted. Only
+ * one process at a time may have the file open; flock
+ * keeps others out.
+ *
+ *******************************************************/
+
+#define _DEFAULT_SOURCE /* for flock */
+#include "history.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "format.h"
+
+/* Identifies a history file and the layout of its entries */
+#define HISTORY_MAGIC "CALCHIST"
+#define HISTORY_VERSION 1
+
+/* Entries a new file has room for */
+#define INITIAL_ENTRIES 1024
+
+/* Significant digits of numbers in history_format, as on the display */
+#define HISTORY_DIGITS 12
+
+/* Start of a history file. Entries follow at HEADER_SIZE. */
+typedef struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t count;
+} Header;
+
+#define HEADER_SIZE 64
+_Static_assert(sizeof(Header) <= HEADER_SIZE, "header too large");
+_Static_assert(sizeof(HistoryEntry) == 40, "entry layout changed");
+
+struct History {
+    int fd;
+    size_t size;      /* Size of the file and of the mapping */
+    size_t capacity;  /* Entries the file has room for */
+    Header *header;   /* Start of the mapping */
+    HistoryEntry *entries;
+};
+
+/* Maps the first size bytes of the file into memory, replacing any
+ * earlier mapping only once the new one exists. Returns false, keeping
+ * the earlier mapping, on error. */
+static bool map(History *history, size_t size)
+{
+    void *start = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       history->fd, 0);
+    if (start == MAP_FAILED) return false;
+
+    if (history->header != NULL) munmap(history->header, history->size);
+    history->size = size;
+    history->capacity = (size - HEADER_SIZE) / sizeof(HistoryEntry);
+    history->header = start;
+    history->entries = (HistoryEntry *)((char *)start + HEADER_SIZE);
+    return true;
+}
+
+/* Is true if the mapped file has a valid header */
+static bool valid(const History *history)
+{
+    const Header *header = history->header;
+
+    return memcmp(header->magic, HISTORY_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == HISTORY_VERSION &&
+           header->entry_size == sizeof(HistoryEntry) &&
+           header->count <= history->capacity;
+}
+
+/* Opens and maps the file at path into history. Returns false on error. */
+static bool open_file(History *history, const char *path)
+{
+    struct stat st;
+
+    history->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (history->fd < 0) return false;
+
+    /* a file mapped by two processes would be grown under one of them */
+    if (flock(history->fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) errno = EBUSY;
+        return false;
+    }
+    if (fstat(history->fd, &st) != 0) return false;
+
+    /* a new file gets a header and room for its first entries */
+    if (st.st_size == 0) {
+        st.st_size = HEADER_SIZE + INITIAL_ENTRIES * sizeof(HistoryEntry);
+        if (ftruncate(history->fd, st.st_size) != 0 ||
+            !map(history, (size_t)st.st_size)) {
+            return false;
+        }
+
+        Header *header = history->header;
+        memcpy(header->magic, HISTORY_MAGIC, sizeof(header->magic));
+        header->version = HISTORY_VERSION;
+        header->entry_size = sizeof(HistoryEntry);
+        header->count = 0;
+        return true;
+    }
+
+    if ((unsigned long long)st.st_size > SIZE_MAX ||
+        st.st_size < HEADER_SIZE + (off_t)sizeof(HistoryEntry)) {
+        errno = EINVAL;
+        return false;
+    }
+    if (!map(history, (size_t)st.st_size)) return false;
+    if (!valid(history)) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+History *history_open(const char *path)
+{
+    History *history = malloc(sizeof(struct History));
+    if (history == NULL) return NULL;
+
+    history->header = NULL;
+    history->fd = -1;
+    if (!open_file(history, path)) {
+        int saved = errno;
+        if (history->header != NULL) munmap(history->header, history->size);
+        if (history->fd >= 0) close(history->fd);
+        free(history);
+        errno = saved;
+        return NULL;
+    }
+    return history;
+}
+
+void history_close(History *history)
+{
+    if (history == NULL) return;
+    munmap(history->header, history->size);
+    close(history->fd);
+    free(history);
+}
+
+bool history_append(History *history, const HistoryEntry *entry)
+{
+    size_t count = history->header->count;
+
+    /* when the mapping is full, map the whole file, which is doubled until
+     * it has room; it is never shrunk below what is already mapped */
+    if (count >= history->capacity) {
+        struct stat st;
+        if (fstat(history->fd, &st) != 0) return false;
+
+        size_t size = ((size_t)st.st_size > history->size) ?
+                      (size_t)st.st_size : history->size;
+        size_t capacity = (size - HEADER_SIZE) / sizeof(HistoryEntry);
+        if (capacity <= count) {
+            while (capacity <= count) capacity *= 2;
+            size = HEADER_SIZE + capacity * sizeof(HistoryEntry);
+            if (ftruncate(history->fd, (off_t)size) != 0) return false;
+        }
+        if (!map(history, size)) return false;
+    }
+
+    history->entries[count] = *entry;
+    history->header->count = count + 1;
+    return true;
+}
+
+size_t history_count(const History *history)
+{
+    size_t count = history->header->count;
+    return (count < history->capacity) ? count : history->capacity;
+}
+
+const HistoryEntry *history_get(const History *history, size_t i)
+{
+    return &history->entries[i];
+}
+
+int history_format(char *buf, size_t size, const HistoryEntry *entry)
+{
+    char left[FMT_LEN], right[FMT_LEN], result[FMT_LEN];
+
+    format_num(left, sizeof(left), entry->left, HISTORY_DIGITS);
+    format_num(right, sizeof(right), entry->right, HISTORY_DIGITS);
+    format_num(result, sizeof(result), entry->result, HISTORY_DIGITS);
+
+    return snprintf(buf, size, "%s %s %s = %s", left,
+                    op_to_str((operator)entry->op), right, result);
+}
@@ -0,0 +1,61 @@
+/*********************** history.h **********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the history tape, a record of every
+ * calculation kept in a file. The file is an append-only
+ * log of fixed-size entries which is mapped into memory,
+ * so opening it reads nothing and entries are found by
+ * their index alone.
+ *
+ *******************************************************/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+/* One completed calculation, such as "2 + 3 = 5". Entries are stored in
+ * the file exactly as laid out here. */
+typedef struct HistoryEntry {
+    double left;      /* Number the operator was applied to */
+    double right;     /* Number entered after the operator */
+    double result;
+    int64_t time;     /* Seconds since the Unix epoch */
+    int32_t op;       /* The operator, DIV to SUB */
+    int32_t reserved; /* Always 0 */
+} HistoryEntry;
+
+/* Size of a buffer which can hold any text written by history_format */
+#define HISTORY_LEN 128
+
+/* An open history file */
+typedef struct History History;
+
+/* Opens the history file at path, creating it if it does not exist.
+ * Returns NULL, with errno set, if the file cannot be opened or is not a
+ * history file, and with errno EBUSY if another process has it open. */
+History *history_open(const char *path);
+
+/* Closes a history file. Entries already appended are kept. */
+void history_close(History *history);
+
+/* Appends an entry to the history. Takes constant time, except when the
+ * file is full, when it is doubled in size. Returns false if the file
+ * could not be grown. */
+bool history_append(History *history, const HistoryEntry *entry);
+
+/* Returns the number of entries in the history */
+size_t history_count(const History *history);
+
+/* Returns the i-th entry, oldest first. The pointer is only valid until
+ * the next call to history_append. */
+const HistoryEntry *history_get(const History *history, size_t i);
+
+/* Writes an entry as text, for example "2 + 3 = 5", to buf, like
+ * snprintf. A buffer of HISTORY_LEN characters is always large enough. */
+int history_format(char *buf, size_t size, const HistoryEntry *entry);
+
+#endif
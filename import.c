@@ -0,0 +1,118 @@
+/************************ import.c **********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of importing. The
+ * worker thread maps the file and evaluates each line in
+ * place with batch mode's batch_eval_line, and shares
+ * nothing with the main thread but the progress counter
+ * and the task.
+ *
+ *******************************************************/
+
+#include "import.h"
+#include <string.h>
+#include "batch.h"
+
+/* Lines evaluated between checks for cancellation and progress reports */
+#define CHECK_LINES 4096
+
+/* State of one import, owned by its task */
+typedef struct Import {
+    char *path;
+    gint *progress;  /* Thousandths of the file done, shared */
+    MemoCache cache; /* The worker thread's own cache */
+} Import;
+
+static void import_free(gpointer user_data)
+{
+    Import *import = user_data;
+    g_free(import->path);
+    g_free(import);
+}
+
+/* Runs on the worker thread */
+static void import_thread(GTask *task, gpointer source, gpointer task_data,
+                          GCancellable *cancellable)
+{
+    (void)source;
+
+    Import *import = task_data;
+    GError *error = NULL;
+
+    GMappedFile *file = g_mapped_file_new(import->path, FALSE, &error);
+    if (file == NULL) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    const char *text = g_mapped_file_get_contents(file);
+    size_t len = g_mapped_file_get_length(file);
+    ImportResult *result = g_new0(ImportResult, 1);
+    size_t pos = 0, count = 0;
+    memo_init(&import->cache);
+
+    while (pos < len) {
+        const char *line = text + pos;
+        const char *newline = memchr(line, '\n', len - pos);
+        size_t n = (newline != NULL) ? (size_t)(newline - line) : len - pos;
+        double value;
+        ExprError expr_error;
+
+        pos += n + 1;
+        count++;
+
+        switch (batch_eval_line(line, n, &import->cache, &value,
+                                &expr_error)) {
+            case BATCH_VALUE:
+                result->lines++;
+                result->total += value;
+                break;
+            case BATCH_ERROR:
+                result->lines++;
+                if (result->failed++ == 0) result->first_failed = count;
+                break;
+            default:
+                break;
+        }
+
+        if (count % CHECK_LINES == 0) {
+            if (g_cancellable_is_cancelled(cancellable)) break;
+            g_atomic_int_set(import->progress, (gint)(pos * 1000 / len));
+        }
+    }
+    g_mapped_file_unref(file);
+
+    if (g_task_return_error_if_cancelled(task)) {
+        g_free(result);
+        return;
+    }
+    g_atomic_int_set(import->progress, 1000);
+    g_task_return_pointer(task, result, g_free);
+}
+
+void import_file_async(const char *path, gint *progress,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback, gpointer user_data)
+{
+    Import *import = g_new(Import, 1);
+    import->path = g_strdup(path);
+    import->progress = progress;
+    g_atomic_int_set(progress, 0);
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, import_file_async);
+    g_task_set_task_data(task, import, import_free);
+    g_task_run_in_thread(task, import_thread);
+    g_object_unref(task);
+}
+
+gboolean import_file_finish(GAsyncResult *res, ImportResult *result,
+                            GError **error)
+{
+    ImportResult *outcome = g_task_propagate_pointer(G_TASK(res), error);
+    if (outcome == NULL) return FALSE;
+
+    *result = *outcome;
+    g_free(outcome);
+    return TRUE;
+}
@@ -0,0 +1,42 @@
+/************************ import.h **********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to importing a file of expressions into the
+ * calculator. The file is evaluated on a worker thread
+ * with GTask, so a large one never holds up the window;
+ * the caller polls its progress once per frame and can
+ * cancel it at any time.
+ *
+ *******************************************************/
+
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <gtk/gtk.h>
+
+/* Outcome of an import */
+typedef struct ImportResult {
+    size_t lines;        /* Expressions evaluated, not counting blanks */
+    size_t failed;       /* Those that did not compile */
+    size_t first_failed; /* Line number of the first of those, or 0 */
+    double total;        /* Sum of the values of the others */
+} ImportResult;
+
+/* Evaluates the expressions in the file at path, one per line, as
+ * "calc --batch" does, and adds up their values. The work is done on a
+ * worker thread, which stores the thousandths of the file done so far in
+ * *progress with g_atomic_int_set; progress must outlive the import.
+ * Cancelling cancellable stops it within a few thousand lines. callback
+ * is called on the calling thread's main context once it has finished,
+ * failed or been cancelled, and should call import_file_finish. */
+void import_file_async(const char *path, gint *progress,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback, gpointer user_data);
+
+/* Stores the outcome of an import in *result and returns TRUE, or returns
+ * FALSE and sets error if the file could not be read or the import was
+ * cancelled, in which case the error is G_IO_ERROR_CANCELLED */
+gboolean import_file_finish(GAsyncResult *res, ImportResult *result,
+                            GError **error);
+
+#endif
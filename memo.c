@@ -0,0 +1,63 @@
+/************************ memo.c ************************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the memo cache.
+ * The argument's bits and the operation are hashed to a
+ * home slot; a few slots from there are searched, and on a
+ * miss the result goes into the first empty one, or into
+ * the home slot if none is empty.
+ *
+ *******************************************************/
+
+#include "memo.h"
+
+/* Slots searched from the home slot before giving up */
+#define MEMO_PROBES 4
+
+void memo_init(MemoCache *cache)
+{
+    cache->hits = 0;
+    cache->misses = 0;
+    for (int i = 0; i < MEMO_SLOTS; i++) cache->slots[i].op = NUL;
+}
+
+bool memo_caches(special op)
+{
+    return op == FAC || op == CBT || op == SIN || op == COS || op == TAN;
+}
+
+/* Returns the home slot of an argument and operation */
+static unsigned home_slot(uint64_t bits, special op)
+{
+    /* Fibonacci hashing: the high bits of the product depend on all of
+     * the key's bits */
+    uint64_t key = bits ^ ((uint64_t)op << 56);
+    return (unsigned)((key * 0x9E3779B97F4A7C15u) >> (64 - MEMO_BITS));
+}
+
+double memo_un_op(MemoCache *cache, double a, special op)
+{
+    if (!memo_caches(op)) return un_op(a, op);
+
+    uint64_t bits;
+    memcpy(&bits, &a, sizeof(bits));
+
+    unsigned home = home_slot(bits, op);
+    MemoSlot *empty = NULL;
+
+    for (unsigned i = 0; i < MEMO_PROBES; i++) {
+        MemoSlot *slot = &cache->slots[(home + i) & (MEMO_SLOTS - 1)];
+        if (slot->op == op && slot->bits == bits) {
+            cache->hits++;
+            return slot->value;
+        }
+        if (slot->op == NUL && empty == NULL) empty = slot;
+    }
+
+    cache->misses++;
+    if (empty == NULL) empty = &cache->slots[home];
+    empty->bits = bits;
+    empty->op = op;
+    empty->value = un_op(a, op);
+    return empty->value;
+}
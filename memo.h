@@ -0,0 +1,49 @@
+/************************ memo.h ************************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the memo cache, which remembers the results
+ * of expensive unary operations so that an argument seen
+ * before costs a table lookup instead of a libm call.
+ *
+ *******************************************************/
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+
+/* Number of results a cache holds */
+#define MEMO_BITS 12
+#define MEMO_SLOTS (1 << MEMO_BITS)
+
+/* One remembered result; op is NUL if the slot is empty */
+typedef struct MemoSlot {
+    uint64_t bits; /* Bit pattern of the argument */
+    double value;  /* un_op of the argument */
+    special op;
+} MemoSlot;
+
+/* A bounded, open-addressed cache of un_op results, keyed by the operation
+ * and the exact bit pattern of the argument, so a hit always returns the
+ * value un_op would. A cache is not thread-safe: give each thread its own.
+ * It holds no pointers and can be freed with the memory it lives in. */
+typedef struct MemoCache {
+    unsigned long hits;   /* Lookups answered from the cache */
+    unsigned long misses; /* Lookups that called un_op */
+    MemoSlot slots[MEMO_SLOTS];
+} MemoCache;
+
+/* Empties a cache and zeroes its counters */
+void memo_init(MemoCache *cache);
+
+/* Returns un_op(a, op), from the cache if possible. Operations cheaper
+ * than a lookup, such as sign change and square, and square root, which
+ * is a single instruction, are always computed. */
+double memo_un_op(MemoCache *cache, double a, special op);
+
+/* Is true if memo_un_op remembers results of op */
+bool memo_caches(special op);
+
+#endif
@@ -0,0 +1,113 @@
+/*********************** startup.c **********************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of startup
+ * tracing. Milestones cost a single branch when tracing
+ * is off.
+ *
+ *******************************************************/
+
+#include "startup.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool tracing;    /* Is true if CALC_STARTUP_TRACE is set */
+static bool quit_after; /* Is true if the first frame ends the process */
+static gint64 origin;   /* Time milestones count from, in microseconds */
+
+/* Prints a milestone reached at time t */
+static void mark_at(const char *name, gint64 t)
+{
+    fprintf(stderr, "startup: %-16s %9.3f ms\n", name, (t - origin) / 1e3);
+}
+
+void startup_init(void)
+{
+    const char *trace = g_getenv("CALC_STARTUP_TRACE");
+    if (trace == NULL || *trace == '\0') return;
+
+    gint64 now = g_get_monotonic_time();
+    const char *t0 = g_getenv("CALC_STARTUP_T0");
+
+    tracing = true;
+    quit_after = (strcmp(trace, "exit") == 0);
+    origin = (t0 != NULL) ? g_ascii_strtoll(t0, NULL, 10) : now;
+
+    if (t0 != NULL) mark_at("process start", origin);
+    mark_at("main", now);
+}
+
+bool startup_tracing(void)
+{
+    return tracing;
+}
+
+void startup_mark(const char *name)
+{
+    if (tracing) mark_at(name, g_get_monotonic_time());
+}
+
+/* Returns the number of widgets in the tree rooted at widget */
+static int count_widgets(GtkWidget *widget)
+{
+    int n = 1;
+    for (GtkWidget *child = gtk_widget_get_first_child(widget);
+         child != NULL; child = gtk_widget_get_next_sibling(child)) {
+        n += count_widgets(child);
+    }
+    return n;
+}
+
+/* Called once a frame has been painted; only the first one counts */
+static void after_paint(GdkFrameClock *clock, gpointer user_data)
+{
+    GtkWindow *window = GTK_WINDOW(user_data);
+
+    g_signal_handlers_disconnect_by_func(clock, after_paint, user_data);
+    startup_mark("first frame");
+    fprintf(stderr, "startup: %-16s %9d\n", "widgets",
+            count_widgets(GTK_WIDGET(window)));
+
+    if (quit_after) {
+        g_application_quit(G_APPLICATION(gtk_window_get_application(window)));
+    }
+}
+
+/* Struct holding a handler for a window's frame clock until it exists */
+typedef struct {
+    GCallback after_paint;
+    gpointer data;
+} FrameWatch;
+
+/* The frame clock exists once the window is realized */
+static void on_realize(GtkWidget *window, gpointer user_data)
+{
+    FrameWatch *watch = (FrameWatch *)user_data;
+
+    g_signal_connect(gtk_widget_get_frame_clock(window), "after-paint",
+                     watch->after_paint, watch->data);
+}
+
+/* Frees a FrameWatch with the "realize" handler it was connected with */
+static void free_watch(gpointer data, GClosure *closure)
+{
+    (void)closure;
+
+    g_free(data);
+}
+
+void startup_on_frame(GtkWidget *window, GCallback after_paint,
+                      gpointer data)
+{
+    FrameWatch *watch = g_new(FrameWatch, 1);
+    watch->after_paint = after_paint;
+    watch->data = data;
+    g_signal_connect_data(window, "realize", G_CALLBACK(on_realize), watch,
+                          free_watch, 0);
+}
+
+void startup_watch(GtkWidget *window)
+{
+    if (tracing) startup_on_frame(window, G_CALLBACK(after_paint), window);
+}
@@ -0,0 +1,47 @@
+/*********************** startup.h **********************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to startup tracing. When the environment
+ * variable CALC_STARTUP_TRACE is set, each milestone of
+ * startup is printed to stderr with the time since the
+ * process started, up to the first frame on screen, and
+ * then the number of widgets in the window:
+ *
+ *   CALC_STARTUP_TRACE=1     print the milestones
+ *   CALC_STARTUP_TRACE=exit  print them, then quit after
+ *                            the first frame
+ *
+ * Times count from main, unless CALC_STARTUP_T0 holds the
+ * g_get_monotonic_time (CLOCK_MONOTONIC, microseconds) at
+ * which the launcher started the process. A traced calc
+ * always starts its own instance, even if another one is
+ * running, so that its own startup is what gets timed.
+ *
+ *******************************************************/
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <gtk/gtk.h>
+#include <stdbool.h>
+
+/* Starts tracing if asked to; call first thing in main */
+void startup_init(void);
+
+/* Returns true if startup is being traced */
+bool startup_tracing(void);
+
+/* Prints a milestone, if tracing */
+void startup_mark(const char *name);
+
+/* Connects after_paint, with data, to the "after-paint" signal of
+ * window's frame clock once the window is realized. Call before the
+ * window is presented. */
+void startup_on_frame(GtkWidget *window, GCallback after_paint,
+                      gpointer data);
+
+/* Prints a milestone when window first paints a frame, if tracing. Call
+ * before the window is presented. */
+void startup_watch(GtkWidget *window);
+
+#endif
@@ -0,0 +1,133 @@
+/************************ tape.c ************************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the history
+ * tape's view: a GListModel whose items are made on demand
+ * from the mapped history file, and a GtkListView of it.
+ *
+ *******************************************************/
+
+#include "tape.h"
+
+struct _CalcTape {
+    GObject parent_instance;
+    History *history;
+    guint count; /* Entries the model has announced to its views */
+};
+
+static void calc_tape_list_model_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(CalcTape, calc_tape, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                              calc_tape_list_model_init))
+
+/* Entries the model can show; a list model has at most G_MAXUINT items */
+static guint visible_count(const CalcTape *tape)
+{
+    size_t count = history_count(tape->history);
+    return (count > G_MAXUINT) ? G_MAXUINT : (guint)count;
+}
+
+static GType calc_tape_get_item_type(GListModel *model)
+{
+    (void)model;
+
+    return GTK_TYPE_STRING_OBJECT;
+}
+
+static guint calc_tape_get_n_items(GListModel *model)
+{
+    return CALC_TAPE(model)->count;
+}
+
+/* Formats the entry at position, counting from the newest */
+static gpointer calc_tape_get_item(GListModel *model, guint position)
+{
+    CalcTape *tape = CALC_TAPE(model);
+    char text[HISTORY_LEN];
+
+    if (position >= tape->count) return NULL;
+
+    size_t i = history_count(tape->history) - 1 - position;
+    history_format(text, sizeof(text), history_get(tape->history, i));
+    return gtk_string_object_new(text);
+}
+
+static void calc_tape_list_model_init(GListModelInterface *iface)
+{
+    iface->get_item_type = calc_tape_get_item_type;
+    iface->get_n_items = calc_tape_get_n_items;
+    iface->get_item = calc_tape_get_item;
+}
+
+static void calc_tape_class_init(CalcTapeClass *klass)
+{
+    (void)klass;
+}
+
+static void calc_tape_init(CalcTape *tape)
+{
+    (void)tape;
+}
+
+CalcTape *calc_tape_new(History *history)
+{
+    CalcTape *tape = g_object_new(CALC_TYPE_TAPE, NULL);
+    tape->history = history;
+    tape->count = visible_count(tape);
+    return tape;
+}
+
+void calc_tape_update(CalcTape *tape)
+{
+    guint count = visible_count(tape);
+    guint added = count - tape->count;
+
+    /* new entries go in at the top */
+    tape->count = count;
+    if (added > 0) {
+        g_list_model_items_changed(G_LIST_MODEL(tape), 0, 0, added);
+    }
+}
+
+/* Gives a new row widget its label */
+static void setup_row(GtkSignalListItemFactory *factory, GtkListItem *item,
+                      gpointer user_data)
+{
+    (void)factory;
+    (void)user_data;
+
+    GtkWidget *label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(label), 1);
+    gtk_list_item_set_child(item, label);
+}
+
+/* Shows an entry in a row widget, which may have shown another before */
+static void bind_row(GtkSignalListItemFactory *factory, GtkListItem *item,
+                     gpointer user_data)
+{
+    (void)factory;
+    (void)user_data;
+
+    GtkWidget *label = gtk_list_item_get_child(item);
+    GtkStringObject *entry = gtk_list_item_get_item(item);
+    gtk_label_set_text(GTK_LABEL(label), gtk_string_object_get_string(entry));
+}
+
+GtkWidget *calc_tape_view_new(CalcTape *tape)
+{
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(setup_row), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(bind_row), NULL);
+
+    /* the view owns the selection model, which owns a reference to tape */
+    GtkNoSelection *model = gtk_no_selection_new(
+        G_LIST_MODEL(g_object_ref(tape)));
+    GtkWidget *list = gtk_list_view_new(GTK_SELECTION_MODEL(model), factory);
+
+    GtkWidget *scroll = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scroll), list);
+    return scroll;
+}
@@ -0,0 +1,33 @@
+/************************ tape.h ************************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the history tape's view. CalcTape is a list
+ * model over a history file, newest calculation first,
+ * which formats an entry only when a row asks for it, so
+ * the view costs the same whatever the history's length.
+ *
+ *******************************************************/
+
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <gtk/gtk.h>
+#include "history.h"
+
+#define CALC_TYPE_TAPE (calc_tape_get_type())
+G_DECLARE_FINAL_TYPE(CalcTape, calc_tape, CALC, TAPE, GObject)
+
+/* Creates a list model of the entries in history, which must stay open
+ * for as long as the model exists. Items are GtkStringObjects holding the
+ * text of an entry, made when they are asked for. */
+CalcTape *calc_tape_new(History *history);
+
+/* Tells the model, and so any view of it, that entries were appended to
+ * its history */
+void calc_tape_update(CalcTape *tape);
+
+/* Creates a scrollable list showing the model's rows. Only the rows in
+ * sight have widgets, and those are reused as the list scrolls. */
+GtkWidget *calc_tape_view_new(CalcTape *tape);
+
+#endif
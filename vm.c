@@ -0,0 +1,90 @@
+/************************* vm.c *************************
+ * Author: Jeremy Lawrence
+ *
+ * This file contains the implementation of the bytecode
+ * virtual machine. With GCC or Clang each instruction jumps
+ * straight to the next one through a table of label
+ * addresses (computed goto); other compilers get a switch.
+ *
+ *******************************************************/
+
+#include "vm.h"
+
+#if defined(__GNUC__)
+#define COMPUTED_GOTO 1
+#else
+#define COMPUTED_GOTO 0
+#endif
+
+#if COMPUTED_GOTO
+#define INSTRUCTION(op) do_##op
+#define DISPATCH() goto *dispatch[*pc++]
+#else
+#define INSTRUCTION(op) case op
+#define DISPATCH() goto next
+#endif
+
+/* Computes the unary operation op on tos, through the cache if there is
+ * one. The check is a well-predicted branch next to a libm call. */
+#define MEMO(op, expr) ((cache != NULL) ? memo_un_op(cache, tos, op) : (expr))
+
+double vm_eval(const Program *prog, double x)
+{
+    return vm_eval_memo(prog, x, NULL);
+}
+
+double vm_eval_memo(const Program *prog, double x, MemoCache *cache)
+{
+    /* the value on top of the stack lives in tos; stack holds the rest,
+     * plus the meaningless tos pushed by the first push */
+    double stack[EXPR_MAX_DEPTH + 1];
+    double *sp = stack;
+    double tos = 0;
+    const double *constant = prog->consts;
+    const unsigned char *pc = prog->code;
+
+#if COMPUTED_GOTO
+    static const void *const dispatch[] = {
+        [OP_NUM] = &&do_OP_NUM, [OP_VAR] = &&do_OP_VAR,
+        [OP_DIV] = &&do_OP_DIV, [OP_MUL] = &&do_OP_MUL,
+        [OP_ADD] = &&do_OP_ADD, [OP_SUB] = &&do_OP_SUB,
+        [OP_FAC] = &&do_OP_FAC, [OP_SQT] = &&do_OP_SQT,
+        [OP_CBT] = &&do_OP_CBT, [OP_SGN] = &&do_OP_SGN,
+        [OP_PCT] = &&do_OP_PCT, [OP_SQR] = &&do_OP_SQR,
+        [OP_CUB] = &&do_OP_CUB, [OP_SIN] = &&do_OP_SIN,
+        [OP_COS] = &&do_OP_COS, [OP_TAN] = &&do_OP_TAN,
+        [OP_END] = &&do_OP_END
+    };
+
+    DISPATCH();
+#else
+next:
+    switch ((opcode)*pc++) {
+#endif
+
+    INSTRUCTION(OP_NUM): *sp++ = tos; tos = *constant++;           DISPATCH();
+    INSTRUCTION(OP_VAR): *sp++ = tos; tos = x;                     DISPATCH();
+
+    INSTRUCTION(OP_DIV): tos = *--sp / tos;                        DISPATCH();
+    INSTRUCTION(OP_MUL): tos = *--sp * tos;                        DISPATCH();
+    INSTRUCTION(OP_ADD): tos = *--sp + tos;                        DISPATCH();
+    INSTRUCTION(OP_SUB): tos = *--sp - tos;                        DISPATCH();
+
+    INSTRUCTION(OP_FAC): tos = MEMO(FAC, factorial(tos));           DISPATCH();
+    INSTRUCTION(OP_SQT): tos = sqrt(tos);                          DISPATCH();
+    INSTRUCTION(OP_CBT): tos = MEMO(CBT, cbrt(tos));               DISPATCH();
+    INSTRUCTION(OP_SGN): tos = 0 - tos;                            DISPATCH();
+    INSTRUCTION(OP_PCT): tos = tos / (float)100;                   DISPATCH();
+    INSTRUCTION(OP_SQR): tos = tos * tos;                          DISPATCH();
+    INSTRUCTION(OP_CUB): tos = tos * tos * tos;                    DISPATCH();
+    INSTRUCTION(OP_SIN): tos = MEMO(SIN, sin(tos));                DISPATCH();
+    INSTRUCTION(OP_COS): tos = MEMO(COS, cos(tos));                DISPATCH();
+    INSTRUCTION(OP_TAN): tos = MEMO(TAN, tan(tos));                DISPATCH();
+
+    INSTRUCTION(OP_END): return tos;
+
+#if !COMPUTED_GOTO
+    }
+    return tos;
+#endif
+}
@@ -0,0 +1,25 @@
+/************************* vm.h *************************
+ * Author: Jeremy Lawrence
+ *
+ * Interface to the bytecode virtual machine, the fast way
+ * of evaluating programs produced by expr_compile.
+ *
+ *******************************************************/
+
+#ifndef VM_H
+#define VM_H
+
+#include "expr.h"
+#include "memo.h"
+
+/* Evaluates a compiled program with the variable x set to x. Gives the
+ * same results as expr_eval, but dispatches each instruction with a single
+ * indirect jump and keeps the top of the stack in a register. Does not
+ * allocate. */
+double vm_eval(const Program *prog, double x);
+
+/* Same as vm_eval, but looks the results of expensive unary operations up
+ * in cache, and remembers them there. Results are identical. */
+double vm_eval_memo(const Program *prog, double x, MemoCache *cache);
+
+#endif